@@ -1,7 +1,9 @@
 
 #include "core_commands.h"
 #include "../rqshell.h"
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 void rqshell_command_exit(int len, char const *c) {
   int ec = 0;
@@ -23,10 +25,312 @@ void rqshell_command_clear(int len, char const *c) {
   rqshell_clear();
 }
 
+static void help_print_command(char const *name, void *user) {
+  rqshell_printlnf("    %s", name);
+}
+
+static void jobs_print_job(char const *name, bool running, void *user) {
+  rqshell_printlnf("    %-20s: %s", name, running ? "running" : "queued");
+}
+
+void rqshell_command_jobs(int len, char const *c) {
+  if (len > 0) {
+    rqshell_println("Error: command 'jobs' does not take any arguments");
+    return;
+  }
+  rqshell_foreach_job(jobs_print_job, NULL);
+}
+
+static void cvar_print(char const *name) {
+  char const *value = rqshell_cvar_get(name);
+  if (value) {
+    rqshell_printlnf("%s = %s", name, value);
+  } else {
+    rqshell_printlnf("Error: %s: no such variable", name);
+  }
+}
+
+void rqshell_command_set(int argc, char const **argv) {
+  if (argc != 3) {
+    rqshell_println("Error: set: expects a variable name and a value");
+    return;
+  }
+  if (rqshell_cvar_set(argv[1], argv[2])) {
+    cvar_print(argv[1]);
+  }
+}
+
+void rqshell_command_get(int argc, char const **argv) {
+  if (argc < 2) {
+    rqshell_println("Error: get: expects a variable name");
+    return;
+  }
+  for (int i = 1; i < argc; ++i) {
+    cvar_print(argv[i]);
+  }
+}
+
+void rqshell_command_toggle(int argc, char const **argv) {
+  if (argc != 2) {
+    rqshell_println("Error: toggle: expects a variable name");
+    return;
+  }
+  if (rqshell_cvar_toggle(argv[1])) {
+    cvar_print(argv[1]);
+  }
+}
+
+struct list_filter {
+  char const *prefix;
+  size_t length;
+  unsigned listed;
+};
+
+static void list_print_cvar(char const *name, char const *type,
+                            char const *value, void *user) {
+  struct list_filter *filter = user;
+  if (strncmp(name, filter->prefix, filter->length) == 0) {
+    rqshell_printlnf("    %-24s %-6s = %s", name, type, value);
+    filter->listed++;
+  }
+}
+
+void rqshell_command_list(int argc, char const **argv) {
+  if (argc > 2) {
+    rqshell_println("Error: list: takes at most one prefix");
+    return;
+  }
+  struct list_filter filter = {.prefix = argc == 2 ? argv[1] : ""};
+  filter.length = strlen(filter.prefix);
+  rqshell_foreach_cvar(list_print_cvar, &filter);
+  if (filter.listed == 0) {
+    rqshell_println("no variables");
+  }
+}
+
+static void watch_print(char const *name, unsigned interval,
+                        char const *value, void *user) {
+  unsigned *listed = user;
+  rqshell_printlnf("    %-24s every %u frames = %s", name, interval, value);
+  ++*listed;
+}
+
+void rqshell_command_watch(int argc, char const **argv) {
+  if (argc == 1) {
+    unsigned listed = 0;
+    rqshell_foreach_watch(watch_print, &listed);
+    if (listed == 0) {
+      rqshell_println("no variables are watched");
+    }
+    return;
+  } else if (argc > 3) {
+    rqshell_println("Error: watch: expects a variable name and an interval");
+    return;
+  }
+
+  long interval = 1;
+  if (argc == 3) {
+    char *end = NULL;
+    interval = strtol(argv[2], &end, 10);
+    if (*end != '\0' || interval <= 0) {
+      rqshell_println("Error: watch: the interval must be a positive number "
+                      "of frames");
+      return;
+    }
+  }
+  rqshell_watch(argv[1], (unsigned)interval);
+}
+
+void rqshell_command_unwatch(int argc, char const **argv) {
+  if (argc > 2) {
+    rqshell_println("Error: unwatch: takes at most one variable name");
+    return;
+  }
+  if (!rqshell_unwatch(argc == 2 ? argv[1] : NULL)) {
+    rqshell_printlnf("Error: %s: variable is not watched", argv[1]);
+  }
+}
+
+static void prof_print_scope(char const *name,
+                             struct rqshell_prof_stats const *stats,
+                             void *user) {
+  unsigned *listed = user;
+  rqshell_printlnf("    %-24s %10llu %9.1f %9.1f %9.1f %9.1f", name,
+                   stats->calls, stats->min_us, stats->avg_us, stats->p99_us,
+                   stats->max_us);
+  ++*listed;
+}
+
+void rqshell_command_prof(int argc, char const **argv) {
+  if (argc > 2) {
+    rqshell_println("Error: prof: takes at most one argument");
+  } else if (argc == 2 && strcmp(argv[1], "reset") == 0) {
+    rqshell_prof_reset();
+  } else if (argc == 2 && strcmp(argv[1], "graph") == 0) {
+    rqshell_prof_show_graph(!rqshell_prof_graph_shown());
+  } else if (argc == 2) {
+    rqshell_printlnf("Error: prof: unknown argument '%s'", argv[1]);
+  } else {
+    unsigned listed = 0;
+    rqshell_printlnf("    %-24s %10s %9s %9s %9s %9s", "scope (us)", "calls",
+                     "min", "avg", "p99", "max");
+    rqshell_prof_foreach(prof_print_scope, &listed);
+    if (listed == 0) {
+      rqshell_println("no scopes were timed, see rqshell_prof_begin");
+    }
+  }
+}
+
+struct cmdstats_entry {
+  char const *name;
+  struct rqshell_command_stats stats;
+};
+
+struct cmdstats_list {
+  struct cmdstats_entry *entries;
+  unsigned count;
+  unsigned cap;
+};
+
+static void cmdstats_collect(char const *name,
+                             struct rqshell_command_stats const *stats,
+                             void *user) {
+  struct cmdstats_list *list = user;
+  if (list->count == list->cap) {
+    unsigned cap = list->cap ? list->cap * 2 : 64;
+    struct cmdstats_entry *entries =
+        realloc(list->entries, cap * sizeof(*entries));
+    if (!entries) {
+      return;
+    }
+    list->entries = entries;
+    list->cap = cap;
+  }
+  list->entries[list->count++] = (struct cmdstats_entry){name, *stats};
+}
+
+static int cmdstats_compare(void const *a, void const *b) {
+  double x = ((struct cmdstats_entry const *)a)->stats.total_ms;
+  double y = ((struct cmdstats_entry const *)b)->stats.total_ms;
+  return (x < y) - (x > y);
+}
+
+void rqshell_command_cmdstats(int argc, char const **argv) {
+  if (argc == 2 && strcmp(argv[1], "reset") == 0) {
+    rqshell_reset_command_stats();
+    return;
+  } else if (argc > 1) {
+    rqshell_println("Error: cmdstats: only takes reset");
+    return;
+  }
+
+  struct cmdstats_list list = {0};
+  rqshell_foreach_command_stats(cmdstats_collect, &list);
+  qsort(list.entries, list.count, sizeof(*list.entries), cmdstats_compare);
+
+  rqshell_printlnf("    %-24s %10s %12s %12s", "command (ms)", "calls", "total",
+                   "max");
+  for (unsigned i = 0; i < list.count; ++i) {
+    struct cmdstats_entry const *entry = list.entries + i;
+    rqshell_printlnf("    %-24s %10llu %12.3f %12.3f", entry->name,
+                     entry->stats.calls, entry->stats.total_ms,
+                     entry->stats.max_ms);
+  }
+  free(list.entries);
+}
+
+static char const *shellstats_size(size_t bytes, char *text, size_t size) {
+  if (bytes < 1024) {
+    snprintf(text, size, "%zu B", bytes);
+  } else if (bytes < 1024 * 1024) {
+    snprintf(text, size, "%.1f KiB", bytes / 1024.0);
+  } else {
+    snprintf(text, size, "%.1f MiB", bytes / (1024.0 * 1024.0));
+  }
+  return text;
+}
+
+void rqshell_command_shellstats(int argc, char const **argv) {
+  if (argc > 1) {
+    rqshell_println("Error: shellstats: does not take any arguments");
+    return;
+  }
+
+  struct rqshell_self_stats stats;
+  rqshell_get_self_stats(&stats);
+
+  rqshell_printlnf("console cost over the last %u frames:", stats.frames);
+  rqshell_printlnf("    %-16s %9s %9s %9s", "step (ms)", "avg", "p99", "max");
+  rqshell_printlnf("    %-16s %9.3f %9.3f %9.3f", "update",
+                   stats.update_avg_ms, stats.update_p99_ms,
+                   stats.update_max_ms);
+  rqshell_printlnf("    %-16s %9.3f %9.3f %9.3f", "render",
+                   stats.render_avg_ms, stats.render_p99_ms,
+                   stats.render_max_ms);
+  rqshell_printlnf("    %-16s %9s %9s", "", "last", "max");
+  rqshell_printlnf("    %-16s %9u %9u", "draw calls", stats.draws,
+                   stats.draws_max);
+  rqshell_printlnf("    %-16s %9u %9u", "glyphs", stats.glyphs,
+                   stats.glyphs_max);
+
+  char size[32];
+  size_t heap = stats.scrollback_bytes + stats.history_bytes +
+                stats.command_bytes + stats.other_bytes;
+  rqshell_println("memory:");
+  rqshell_printlnf("    %-16s %12s  %u lines", "scrollback",
+                   shellstats_size(stats.scrollback_bytes, size, sizeof(size)),
+                   stats.scrollback_lines);
+  rqshell_printlnf("    %-16s %12s", "history",
+                   shellstats_size(stats.history_bytes, size, sizeof(size)));
+  rqshell_printlnf("    %-16s %12s", "commands",
+                   shellstats_size(stats.command_bytes, size, sizeof(size)));
+  rqshell_printlnf("    %-16s %12s", "other",
+                   shellstats_size(stats.other_bytes, size, sizeof(size)));
+  rqshell_printlnf("    %-16s %12s", "heap total",
+                   shellstats_size(heap, size, sizeof(size)));
+  rqshell_printlnf("    %-16s %12s", "console state",
+                   shellstats_size(stats.static_bytes, size, sizeof(size)));
+  rqshell_printlnf(
+      "    %-16s %12s", "history file",
+      shellstats_size(stats.history_mapped_bytes, size, sizeof(size)));
+  rqshell_printlnf("    %-16s %12s  video memory", "render targets",
+                   shellstats_size(stats.texture_bytes, size, sizeof(size)));
+  rqshell_printlnf("    %u commands registered", stats.commands);
+}
+
+static void complete_cvar_name(char const *name, char const *type,
+                               char const *value, void *user) {
+  rqshell_completion_add(user, name);
+}
+
+void rqshell_complete_cvar(struct rqshell_completion *c, int argc,
+                           char const **argv) {
+  if (argc == 2 || strcmp(argv[0], "get") == 0) {
+    rqshell_foreach_cvar(complete_cvar_name, c);
+  }
+}
+
 void rqshell_command_help(int len, char const *c) {
   rqshell_println("command help:");
   rqshell_println("    clear               : clears the text pane of text");
   rqshell_println(
       "    exit <exit_code>    : exits the program with exit code <exit_code>");
+  rqshell_println(
+      "    jobs                : lists the commands running in the background");
+  rqshell_println("    set <name> <value>  : sets a variable");
+  rqshell_println("    get <name>...       : shows the value of variables");
+  rqshell_println("    toggle <name>       : flips a bool variable");
+  rqshell_println(
+      "    list [prefix]       : lists the variables and their values");
+  rqshell_println(
+      "    watch <name> [n]    : pins a variable, sampled every n frames");
+  rqshell_println("    unwatch [name]      : unpins a variable, or all of them");
+  rqshell_println(
+      "    prof [reset|graph]  : shows the timed scopes or the frame graph");
+  rqshell_println("    cmdstats [reset]    : shows how long commands took");
+  rqshell_println("    time <command>      : runs a command and shows its cost");
+  rqshell_println("    shellstats          : shows what the console costs");
   rqshell_println("");
+  rqshell_println("all commands:");
+  rqshell_foreach_command(help_print_command, NULL);
 }
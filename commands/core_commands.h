@@ -2,10 +2,66 @@
 #ifndef _HEADER_FILE_core_commands_20230315191255_
 #define _HEADER_FILE_core_commands_20230315191255_
 
+#include "../rqshell.h"
+
 void rqshell_command_exit(int len, char const *c);
 
 void rqshell_command_clear(int len, char const *c);
 
 void rqshell_command_help(int len, char const *c);
 
+void rqshell_command_jobs(int len, char const *c);
+
+/*
+ * set <name> <value>
+ * get <name>...
+ * toggle <name>
+ * list [prefix]
+ * Read and change the variables bound with rqshell_cvar_bind_*.
+ */
+void rqshell_command_set(int argc, char const **argv);
+
+void rqshell_command_get(int argc, char const **argv);
+
+void rqshell_command_toggle(int argc, char const **argv);
+
+void rqshell_command_list(int argc, char const **argv);
+
+/*
+ * watch [<name> [frames]]
+ * unwatch [name]
+ * Pin variables above the prompt, sampled every few frames, or list the
+ * pinned ones. unwatch without a name unpins them all.
+ */
+void rqshell_command_watch(int argc, char const **argv);
+
+void rqshell_command_unwatch(int argc, char const **argv);
+
+/*
+ * prof [reset | graph]
+ * Lists the rolling statistics of the profiled scopes, forgets them, or
+ * shows and hides the frame time graph.
+ */
+void rqshell_command_prof(int argc, char const **argv);
+
+/*
+ * cmdstats [reset]
+ * Lists the call count, total and worst latency of the commands that ran,
+ * slowest in total first, or forgets them.
+ */
+void rqshell_command_cmdstats(int argc, char const **argv);
+
+/*
+ * shellstats
+ * Shows what the console itself costs: the time its update and render steps
+ * took over the latest frames, what they drew, and the memory it holds.
+ */
+void rqshell_command_shellstats(int argc, char const **argv);
+
+/*
+ * Completer offering the names of the bound variables.
+ */
+void rqshell_complete_cvar(struct rqshell_completion *c, int argc,
+                           char const **argv);
+
 #endif
\ No newline at end of file
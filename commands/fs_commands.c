@@ -1,23 +1,107 @@
+#define _GNU_SOURCE // memmem
 #include "fs_commands.h"
-#include "../rqshell_args.h"
 #include "../rqshell.h"
+#include "../rqshell_args.h"
+#include "../rqshell_config.h"
+#include "../rqshell_walk.h"
 #include "raylib.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <math.h>
+#include <stdatomic.h>
 #include <stdbool.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include "config.h"
 
-static inline bool ls_print_file(char const *path) {
-  if (DirectoryExists(path)) {
-    FilePathList p = LoadDirectoryFiles(path);
+#define LS_PAGE_SIZE (100) // entries per page when paging without -n
+#define SEARCH_LIMIT (1000) // most lines printed by find and grep
+#define GREP_SHOWN (200) // most characters of a matching line printed by grep
+#define GREP_BINARY_CHECK (4096) // bytes checked for a null byte by grep
+#define VIEW_LINES (10) // lines shown by head and tail without -n
+#define PATH_CACHE_DIRS (16) // directory listings kept for completion
+
+// Progress of an ls command, kept between task steps.
+struct ls_state {
+  long limit; // most entries listed per path, negative for no limit
+  long page; // 1 based page of limit entries to list
+  int arg; // argv index of the path being listed, 0 before the first
+  bool listed; // at least one path was listed
+
+  DIR *dir; // null when no directory is being read
+  char path[LINE_SIZE]; // directory being read
+  char const *pattern; // glob the entry names must match, or null
+  long matched; // matching entries of the directory so far
+};
+
+// Number of argv entries taken by the option at argv[i], 0 if not an option.
+static int ls_option_size(int argc, char const **argv, int i) {
+  if (strcmp(argv[i], "-n") == 0 || strcmp(argv[i], "--page") == 0) {
+    return i + 1 < argc ? 2 : 1;
+  }
+  return 0;
+}
 
-    for (unsigned i = 0; i < p.count; ++i) {
-      rqshell_printlnf("%s", p.paths[i]);
+static bool ls_parse_options(struct ls_state *ls, int argc, char const **argv) {
+  for (int i = 1; i < argc; ++i) {
+    if (!ls_option_size(argc, argv, i)) {
+      continue;
     }
 
-    UnloadDirectoryFiles(p);
+    char *end = NULL;
+    long value = i + 1 < argc ? strtol(argv[i + 1], &end, 10) : 0;
+    if (!end || *end != '\0' || value <= 0) {
+      rqshell_printlnf("Error: ls: %s expects a positive number", argv[i]);
+      return false;
+    }
+
+    if (argv[i][1] == 'n') {
+      ls->limit = value;
+    } else {
+      ls->page = value;
+    }
+    i++;
+  }
+
+  if (ls->page > 1 && ls->limit < 0) {
+    ls->limit = LS_PAGE_SIZE;
+  }
+  return true;
+}
+
+// Start listing path. A glob in the last path component, like "assets/*.png",
+// filters the directory entries by name, unless the path exists as written.
+static bool ls_open(struct ls_state *ls, char const *path) {
+  snprintf(ls->path, LINE_SIZE, "%s", path);
+  ls->pattern = NULL;
+  ls->matched = 0;
+
+  char *name = strrchr(ls->path, '/');
+  name = name ? name + 1 : ls->path;
+  if (strpbrk(name, "*?[") && !DirectoryExists(path) && !FileExists(path)) {
+    ls->pattern = path + (name - ls->path);
+    if (name == ls->path) {
+      strcpy(ls->path, ".");
+    } else if (name - 1 == ls->path) {
+      name[0] = '\0'; // keep the root
+    } else {
+      name[-1] = '\0';
+    }
+  }
+
+  if (DirectoryExists(ls->path)) {
+    ls->dir = opendir(ls->path);
+    if (!ls->dir) {
+      rqshell_printlnf("Error: %s: could not open directory", ls->path);
+      return false;
+    }
     return true;
-  } else if (FileExists(path)) {
+  } else if (!ls->pattern && FileExists(path)) {
     rqshell_println(path);
     return true;
   } else {
@@ -26,60 +110,857 @@ static inline bool ls_print_file(char const *path) {
   }
 }
 
-void rqshell_command_pwd(int cs, char const *cc) {
-  if (cs > 0) {
+// Open the next path argument, or the working directory if none was given.
+// Returns false when there is nothing left to list.
+static bool ls_open_next(struct ls_state *ls, int argc, char const **argv) {
+  for (int i = ls->arg + 1; i < argc; ++i) {
+    int option = ls_option_size(argc, argv, i);
+    if (option) {
+      i += option - 1;
+      continue;
+    }
+
+    if (ls->listed) {
+      rqshell_printlnf("===> '%s'", argv[i]);
+    }
+    ls->arg = i;
+    ls->listed = true;
+    return ls_open(ls, argv[i]);
+  }
+
+  if (!ls->listed) {
+    ls->arg = argc;
+    ls->listed = true;
+    return ls_open(ls, GetWorkingDirectory());
+  }
+  return false;
+}
+
+static void ls_close(struct ls_state *ls) {
+  if (ls->dir) {
+    closedir(ls->dir);
+    ls->dir = NULL;
+  }
+}
+
+// List the next entry of the directory being read.
+static void ls_next_entry(struct ls_state *ls) {
+  struct dirent *entry = readdir(ls->dir);
+  if (!entry) {
+    ls_close(ls);
+    return;
+  }
+
+  char const *name = entry->d_name;
+  if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0) {
+    return;
+  }
+  if (ls->pattern && fnmatch(ls->pattern, name, 0) != 0) {
+    return;
+  }
+
+  long first = ls->limit < 0 ? 0 : (ls->page - 1) * ls->limit;
+  long index = ls->matched++;
+  if (index < first) {
+    return;
+  }
+  if (ls->limit >= 0 && index >= first + ls->limit) {
+    rqshell_printlnf("-- more entries, see page %ld with '--page %ld' --",
+                     ls->page + 1, ls->page + 1);
+    ls_close(ls);
+    return;
+  }
+
+  size_t len = strlen(ls->path);
+  bool slash = len > 0 && ls->path[len - 1] == '/';
+  rqshell_printlnf("%s%s%s", ls->path, slash ? "" : "/", name);
+}
+
+void rqshell_command_pwd_argv(int argc, char const **argv) {
+  if (argc > 1) {
     rqshell_println("'pwd' does not take any arguments");
     return;
   }
   rqshell_println(GetWorkingDirectory());
 }
 
+enum rqshell_task_status rqshell_command_ls_task(struct rqshell_task *task,
+                                                 int argc, char const **argv) {
+  struct ls_state *ls = task->state;
+
+  if (!ls) {
+    ls = calloc(1, sizeof(*ls));
+    if (!ls) {
+      rqshell_println("Error: ls: out of memory");
+      return RQSHELL_TASK_DONE;
+    }
+    *ls = (struct ls_state){.limit = -1, .page = 1};
+    task->state = ls;
+
+    if (!ls_parse_options(ls, argc, argv)) {
+      free(ls);
+      return RQSHELL_TASK_DONE;
+    }
+  }
+
+  // entries are read one at a time, so huge directories never need to be
+  // loaded as a whole and the listing is spread over several frames
+  bool done = task->cancelled;
+  while (!done && !rqshell_task_should_yield(task)) {
+    if (ls->dir) {
+      ls_next_entry(ls);
+    } else if (!ls_open_next(ls, argc, argv)) {
+      done = true;
+    }
+  }
+
+  if (done) {
+    ls_close(ls);
+    free(ls);
+    return RQSHELL_TASK_DONE;
+  }
+  return RQSHELL_TASK_RUNNING;
+}
+
+void rqshell_command_cd_argv(int argc, char const **argv) {
+  static const char *home = NULL;
+  if (!home) {
+    home = strdup(GetWorkingDirectory());
+  }
+
+  if (argc == 1) {
+    return;
+  } else if (argc > 2) {
+    rqshell_println("Error: cd: too many arguments parsed to cd");
+    return;
+  }
+
+  char const *c = argv[1];
+  if (strcmp(c, "~") == 0) {
+    rqshell_printlnf("%s", home);
+    ChangeDirectory(home);
+  } else if (DirectoryExists(c)) {
+    rqshell_printlnf("%s", c);
+    ChangeDirectory(c);
+  } else {
+    rqshell_printlnf("Error: %s: No such directory", c);
+  }
+}
+
+// Split the raw argument line of an rqshell_register handler into argv the
+// way the dispatcher does, with the command name first.
+// Returns argc, or -1 after printing an error.
+static int fs_split_line(char const *name, int cs, char const *cc,
+                         char line[LINE_SIZE], char const *argv[N_ARGS + 1]) {
+  int len = cs < LINE_SIZE ? cs : LINE_SIZE - 1;
+  memcpy(line, cc, len);
+  line[len] = '\0';
+
+  argv[0] = name;
+  int argc = rqshell_arg_split(line, len, argv + 1, N_ARGS - 1);
+  if (argc < 0) {
+    rqshell_printlnf("Error: %s: malformed arguments", name);
+    return -1;
+  } else if (argc > N_ARGS - 1) {
+    rqshell_printlnf("Error: %s: too many arguments", name);
+    return -1;
+  }
+  argv[argc + 1] = NULL;
+  return argc + 1;
+}
+
+void rqshell_command_pwd(int cs, char const *cc) {
+  char line[LINE_SIZE];
+  char const *argv[N_ARGS + 1];
+  int argc = fs_split_line("pwd", cs, cc, line, argv);
+  if (argc > 0) {
+    rqshell_command_pwd_argv(argc, argv);
+  }
+}
+
+// Run the ls task to completion in one go.
 void rqshell_command_ls(int cs, char const *cc) {
-  struct rqshell_arg_iter iter = rqshell_arg_iter_init(cc, cs);
-  int arg_count = rqshell_arg_iter_count_args(&iter);
+  char line[LINE_SIZE];
+  char const *argv[N_ARGS + 1];
+  int argc = fs_split_line("ls", cs, cc, line, argv);
+  if (argc > 0) {
+    struct rqshell_task task = {.progress = -1.f, .deadline = INFINITY};
+    while (rqshell_command_ls_task(&task, argc, argv) ==
+           RQSHELL_TASK_RUNNING) {
+    }
+  }
+}
+
+void rqshell_command_cd(int cs, char const *cc) {
+  char line[LINE_SIZE];
+  char const *argv[N_ARGS + 1];
+  int argc = fs_split_line("cd", cs, cc, line, argv);
+  if (argc > 0) {
+    rqshell_command_cd_argv(argc, argv);
+  }
+}
+
+// A directory listing kept for completion. Directories are told apart by
+// device and inode, so a relative path still finds its listing after cd.
+struct path_listing {
+  dev_t dev;
+  ino_t ino;
+  struct timespec mtime; // the directory's modification time when read
+  unsigned long long used; // completions before the last use, 0 when unused
+
+  char *names; // the entry names back to back, directories end in '/'
+  size_t names_used;
+  size_t names_cap;
+  char const **sorted; // the names in byte order
+  size_t count;
+};
+
+static struct {
+  struct path_listing dirs[PATH_CACHE_DIRS];
+  unsigned long long completions;
+} path_cache;
+
+static int path_compare(void const *a, void const *b) {
+  return strcmp(*(char const *const *)a, *(char const *const *)b);
+}
+
+static bool path_listing_push(struct path_listing *listing, char const *name,
+                              bool is_dir) {
+  size_t length = strlen(name);
+  if (listing->names_used + length + 2 > listing->names_cap) {
+    size_t cap = listing->names_cap ? listing->names_cap * 2 : 4096;
+    while (cap < listing->names_used + length + 2) {
+      cap *= 2;
+    }
+    char *names = realloc(listing->names, cap);
+    if (!names) {
+      return false;
+    }
+    listing->names = names;
+    listing->names_cap = cap;
+  }
+
+  char *copy = listing->names + listing->names_used;
+  memcpy(copy, name, length);
+  if (is_dir) {
+    copy[length++] = '/';
+  }
+  copy[length] = '\0';
+  listing->names_used += length + 1;
+  listing->count++;
+  return true;
+}
+
+// Read the entries of dir into the listing, sorted so the names sharing a
+// prefix can be found with a binary search.
+static bool path_listing_read(struct path_listing *listing, char const *dir) {
+  listing->names_used = 0;
+  listing->count = 0;
+
+  DIR *d = opendir(dir);
+  if (!d) {
+    return false;
+  }
+  for (struct dirent *entry; (entry = readdir(d));) {
+    char const *name = entry->d_name;
+    if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0) {
+      continue;
+    }
+    bool is_dir = entry->d_type == DT_DIR;
+    struct stat st;
+    if ((entry->d_type == DT_UNKNOWN || entry->d_type == DT_LNK) &&
+        fstatat(dirfd(d), name, &st, 0) == 0) {
+      is_dir = S_ISDIR(st.st_mode); // complete links to directories too
+    }
+    if (!path_listing_push(listing, name, is_dir)) {
+      closedir(d);
+      return false;
+    }
+  }
+  closedir(d);
+
+  char const **sorted =
+      realloc(listing->sorted, (listing->count + 1) * sizeof(*sorted));
+  if (!sorted) {
+    return false;
+  }
+  listing->sorted = sorted;
+  char const *name = listing->names;
+  for (size_t i = 0; i < listing->count; ++i) {
+    sorted[i] = name;
+    name += strlen(name) + 1;
+  }
+  qsort(sorted, listing->count, sizeof(*sorted), path_compare);
+  return true;
+}
+
+// Get the listing of dir, reading it again only when its modification time
+// changed. The least recently used listing makes room for a new one.
+static struct path_listing const *path_listing_get(char const *dir) {
+  struct stat st;
+  if (stat(dir, &st) != 0 || !S_ISDIR(st.st_mode)) {
+    return NULL;
+  }
+
+  struct path_listing *listing = NULL;
+  struct path_listing *oldest = path_cache.dirs;
+  for (int i = 0; i < PATH_CACHE_DIRS; ++i) {
+    struct path_listing *at = path_cache.dirs + i;
+    if (at->used && at->dev == st.st_dev && at->ino == st.st_ino) {
+      listing = at;
+      break;
+    }
+    if (at->used < oldest->used) {
+      oldest = at;
+    }
+  }
+
+  path_cache.completions++;
+  if (listing && listing->mtime.tv_sec == st.st_mtim.tv_sec &&
+      listing->mtime.tv_nsec == st.st_mtim.tv_nsec) {
+    listing->used = path_cache.completions;
+    return listing;
+  }
+
+  listing = listing ? listing : oldest;
+  listing->used = 0;
+  if (!path_listing_read(listing, dir)) {
+    return NULL;
+  }
+  listing->dev = st.st_dev;
+  listing->ino = st.st_ino;
+  listing->mtime = st.st_mtim;
+  listing->used = path_cache.completions;
+  return listing;
+}
+
+static void complete_path(struct rqshell_completion *c, char const *word,
+                          bool dirs_only) {
+  char const *slash = strrchr(word, '/');
+  int dir_length = slash ? (int)(slash - word) + 1 : 0;
+  char const *base = word + dir_length;
+  size_t base_length = strlen(base);
+
+  char path[LINE_SIZE];
+  snprintf(path, LINE_SIZE, "%.*s", dir_length, word);
+  struct path_listing const *listing = path_listing_get(
+      dir_length ? path : ".");
+  if (!listing) {
+    return;
+  }
+
+  // the first name not ordered before the base
+  size_t low = 0, high = listing->count;
+  while (low < high) {
+    size_t mid = low + (high - low) / 2;
+    if (strcmp(listing->sorted[mid], base) < 0) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+
+  for (size_t i = low; i < listing->count; ++i) {
+    char const *name = listing->sorted[i];
+    if (strncmp(name, base, base_length) != 0) {
+      break;
+    }
+    if ((name[0] == '.' && base[0] != '.') ||
+        (dirs_only && name[strlen(name) - 1] != '/')) {
+      continue; // hidden entries only complete when asked for
+    }
+    snprintf(path + dir_length, LINE_SIZE - dir_length, "%s", name);
+    rqshell_completion_add(c, path);
+  }
+}
+
+void rqshell_complete_path(struct rqshell_completion *c, int argc,
+                           char const **argv) {
+  complete_path(c, argv[argc - 1], false);
+}
+
+void rqshell_complete_directory(struct rqshell_completion *c, int argc,
+                                char const **argv) {
+  complete_path(c, argv[argc - 1], true);
+}
+
+enum view_mode {
+  VIEW_CAT,
+  VIEW_HEAD,
+  VIEW_TAIL,
+};
+
+// Progress of a cat, head or tail command, kept between task steps.
+struct view_state {
+  enum view_mode mode;
+  long lines; // lines shown by head and tail
+  int arg; // argv index of the file being shown
+  int files; // number of file arguments
+
+  char const *data; // the mapped file, null when no file is open
+  size_t size;
+  size_t pos; // offset of the next line to show
+  size_t end; // offset where showing stops
+  long remaining; // lines head still shows
+};
+
+// Offset of the last n lines of data. Only the end of the data is scanned,
+// so the cost depends on n and not on the size of the file.
+static size_t view_tail_start(char const *data, size_t size, long n) {
+  size_t end = size;
+  if (end > 0 && data[end - 1] == '\n') {
+    end--; // the final newline ends the last line, it does not start one
+  }
+  if (n <= 0) {
+    return size;
+  }
+
+  for (;;) {
+    char const *nl = memrchr(data, '\n', end);
+    if (!nl) {
+      return 0;
+    }
+    if (--n == 0) {
+      return (size_t)(nl - data) + 1;
+    }
+    end = (size_t)(nl - data);
+  }
+}
 
-  if (arg_count == 0) {
-    char const *pwd = GetWorkingDirectory();
-    ls_print_file(pwd);
+static void view_close(struct view_state *view) {
+  if (view->data) {
+    munmap((void *)view->data, view->size);
+    view->data = NULL;
+  }
+}
+
+// Map the file and find the part of it to show. Opening does not block, so
+// naming a FIFO fails the type check instead of waiting for a writer.
+static bool view_open(struct view_state *view, char const *path,
+                      char const *command) {
+  int fd = open(path, O_RDONLY | O_NONBLOCK);
+  if (fd < 0) {
+    rqshell_printlnf("Error: %s: %s: no such file", command, path);
+    return false;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+    rqshell_printlnf("Error: %s: %s: not a file", command, path);
+    close(fd);
+    return false;
+  }
+
+  view->size = (size_t)st.st_size;
+  view->pos = view->end = 0;
+  if (view->size == 0) {
+    close(fd);
+    return true;
+  }
+
+  char const *data = mmap(NULL, view->size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    rqshell_printlnf("Error: %s: %s: could not map the file", command, path);
+    return false;
+  }
+
+  view->data = data;
+  view->end = view->size;
+  view->remaining = view->lines;
+  if (view->mode == VIEW_TAIL) {
+    view->pos = view_tail_start(data, view->size, view->lines);
   } else {
-    const char *c = 0;
-    int i = 0;
-    while ((c = rqshell_arg_iter_next(&iter))) {
-      if (i > 0) {
-        rqshell_printlnf("===> '%s'", c);
+    posix_madvise((void *)data, view->size, POSIX_MADV_SEQUENTIAL);
+  }
+  return true;
+}
+
+// Show the next line, split into several console lines when it is too long.
+// The text goes from the mapping straight into the scrollback.
+static void view_next_line(struct view_state *view) {
+  char const *line = view->data + view->pos;
+  size_t left = view->end - view->pos;
+
+  char const *nl = memchr(line, '\n', left);
+  size_t len = nl ? (size_t)(nl - line) : left;
+  view->pos += nl ? len + 1 : len;
+
+  if (len > 0 && line[len - 1] == '\r') {
+    len--;
+  }
+  do {
+    int chunk = len < LINE_SIZE - 1 ? (int)len : LINE_SIZE - 1;
+    rqshell_printlnn(line, chunk);
+    line += chunk;
+    len -= chunk;
+  } while (len > 0);
+
+  if (view->mode == VIEW_HEAD && --view->remaining <= 0) {
+    view->pos = view->end;
+  }
+}
+
+static bool view_parse_options(struct view_state *view, int argc,
+                               char const **argv) {
+  view->lines = VIEW_LINES;
+  for (int i = 1; i < argc; ++i) {
+    if (view->mode != VIEW_CAT && strcmp(argv[i], "-n") == 0) {
+      char *end = NULL;
+      long value = i + 1 < argc ? strtol(argv[i + 1], &end, 10) : -1;
+      if (!end || *end != '\0' || value < 0) {
+        rqshell_printlnf("Error: %s: -n expects a number", argv[0]);
+        return false;
       }
-      if (!ls_print_file(c)) {
+      view->lines = value;
+      i++;
+    } else {
+      view->files++;
+    }
+  }
+
+  if (view->files == 0) {
+    rqshell_printlnf("Error: %s: expects a file", argv[0]);
+    return false;
+  }
+  return true;
+}
+
+// Open the next file argument, false when there is none left or it failed.
+static bool view_open_next(struct view_state *view, int argc,
+                           char const **argv) {
+  for (int i = view->arg + 1; i < argc; ++i) {
+    if (view->mode != VIEW_CAT && strcmp(argv[i], "-n") == 0) {
+      i++;
+      continue;
+    }
+
+    view->arg = i;
+    if (view->files > 1 && view->mode != VIEW_CAT) {
+      rqshell_printlnf("==> %s <==", argv[i]);
+    }
+    return view_open(view, argv[i], argv[0]);
+  }
+  return false;
+}
+
+static enum rqshell_task_status view_step(struct rqshell_task *task, int argc,
+                                          char const **argv,
+                                          enum view_mode mode) {
+  struct view_state *view = task->state;
+
+  if (!view) {
+    view = calloc(1, sizeof(*view));
+    if (!view) {
+      rqshell_printlnf("Error: %s: out of memory", argv[0]);
+      return RQSHELL_TASK_DONE;
+    }
+    view->mode = mode;
+    task->state = view;
+
+    if (!view_parse_options(view, argc, argv)) {
+      free(view);
+      return RQSHELL_TASK_DONE;
+    }
+  }
+
+  bool done = task->cancelled;
+  while (!done && !rqshell_task_should_yield(task)) {
+    if (view->pos < view->end &&
+        (view->mode != VIEW_HEAD || view->remaining > 0)) {
+      view_next_line(view);
+    } else {
+      view_close(view);
+      done = !view_open_next(view, argc, argv);
+    }
+  }
+
+  if (done) {
+    view_close(view);
+    free(view);
+    return RQSHELL_TASK_DONE;
+  }
+
+  task->progress = view->end ? (float)view->pos / (float)view->end : -1.f;
+  return RQSHELL_TASK_RUNNING;
+}
+
+enum rqshell_task_status rqshell_command_cat(struct rqshell_task *task,
+                                             int argc, char const **argv) {
+  return view_step(task, argc, argv, VIEW_CAT);
+}
+
+enum rqshell_task_status rqshell_command_head(struct rqshell_task *task,
+                                              int argc, char const **argv) {
+  return view_step(task, argc, argv, VIEW_HEAD);
+}
+
+enum rqshell_task_status rqshell_command_tail(struct rqshell_task *task,
+                                              int argc, char const **argv) {
+  return view_step(task, argc, argv, VIEW_TAIL);
+}
+
+// State shared by the threads walking for find, grep and du.
+struct fs_search {
+  struct rqshell_job *job;
+  char const *pattern;
+  size_t pattern_len;
+  atomic_long results; // result lines claimed so far
+  atomic_ullong bytes;
+  atomic_ullong files;
+  atomic_ullong dirs;
+};
+
+static void fs_search_init(struct fs_search *search, struct rqshell_job *job,
+                           char const *pattern) {
+  search->job = job;
+  search->pattern = pattern;
+  search->pattern_len = pattern ? strlen(pattern) : 0;
+  atomic_init(&search->results, 0);
+  atomic_init(&search->bytes, 0);
+  atomic_init(&search->files, 0);
+  atomic_init(&search->dirs, 0);
+}
+
+static void fs_search_thread_start(void *user) {
+  struct fs_search *search = user;
+  rqshell_job_attach(search->job);
+}
+
+// Claim a result line, false once the limit is reached.
+static bool fs_search_claim(struct fs_search *search) {
+  return atomic_fetch_add_explicit(&search->results, 1, memory_order_relaxed) <
+         SEARCH_LIMIT;
+}
+
+static void fs_search_report(struct fs_search const *search,
+                             char const *command) {
+  if (atomic_load(&search->results) > SEARCH_LIMIT) {
+    rqshell_printlnf("-- %s: stopped after %d results --", command,
+                     SEARCH_LIMIT);
+  }
+}
+
+static bool find_visit(struct rqshell_walk_entry const *entry, void *user) {
+  struct fs_search *search = user;
+  if (rqshell_job_cancelled(search->job)) {
+    return false;
+  }
+  if (search->pattern && fnmatch(search->pattern, entry->name, 0) != 0) {
+    return true;
+  }
+  if (!fs_search_claim(search)) {
+    return false;
+  }
+  rqshell_println(entry->path);
+  return true;
+}
+
+void rqshell_command_find(struct rqshell_job *job, int argc,
+                          char const **argv) {
+  char const *dir = NULL;
+  char const *pattern = NULL;
+
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "-name") == 0) {
+      if (i + 1 >= argc) {
+        rqshell_println("Error: find: -name expects a pattern");
         return;
       }
-      i++;
+      pattern = argv[++i];
+    } else if (!dir) {
+      dir = argv[i];
+    } else {
+      rqshell_println("Error: find: too many arguments");
+      return;
     }
   }
+  if (!dir) {
+    dir = ".";
+  }
+
+  struct fs_search search;
+  fs_search_init(&search, job, pattern);
+  struct rqshell_walk walk = {
+      .visit = find_visit,
+      .thread_start = fs_search_thread_start,
+      .user = &search,
+  };
+
+  if (!rqshell_walk(dir, &walk)) {
+    rqshell_printlnf("Error: find: %s: No such directory", dir);
+    return;
+  }
+  fs_search_report(&search, "find");
 }
 
-void rqshell_command_cd(int cs, char const *cc) {
-  static const char *home = NULL;
-  if (!home) {
-    home = strdup(GetWorkingDirectory());
+// Print the lines of the mapped file that contain the search pattern.
+static bool grep_lines(struct fs_search *search, char const *path,
+                       char const *data, size_t size) {
+  char const *end = data + size;
+  char const *from = data; // where the next match is looked for
+  char const *counted = data; // newlines before this are counted
+  char const *line = data; // start of the line holding counted
+  long line_number = 1;
+
+  char const *match;
+  while (from < end && (match = memmem(from, end - from, search->pattern,
+                                       search->pattern_len))) {
+    for (char const *nl; (nl = memchr(counted, '\n', match - counted));
+         counted = nl + 1) {
+      line_number++;
+      line = nl + 1;
+    }
+    counted = match;
+
+    char const *line_end = memchr(match, '\n', end - match);
+    if (!line_end) {
+      line_end = end;
+    }
+
+    if (rqshell_job_cancelled(search->job) || !fs_search_claim(search)) {
+      return false;
+    }
+
+    int shown = line_end - line < GREP_SHOWN ? (int)(line_end - line) : GREP_SHOWN;
+    if (shown > 0 && line[shown - 1] == '\r') {
+      shown--;
+    }
+    rqshell_printlnf("%s:%ld: %.*s", path, line_number, shown, line);
+
+    from = line_end;
+  }
+
+  return !rqshell_job_cancelled(search->job);
+}
+
+// Search a file by mapping it, so the kernel pages it in as it is scanned
+// and nothing is copied. Opening does not block, so a FIFO that turns up
+// anyway fails the type check. Returns false when the search should stop.
+static bool grep_file(struct fs_search *search, char const *path) {
+  int fd = open(path, O_RDONLY | O_NONBLOCK);
+  if (fd < 0) {
+    return true;
   }
 
-  struct rqshell_arg_iter iter = rqshell_arg_iter_init(cc, cs);
-  int arg_count = rqshell_arg_iter_count_args(&iter);
+  struct stat st;
+  if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+    close(fd);
+    return true;
+  }
+
+  size_t size = (size_t)st.st_size;
+  char const *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    return true;
+  }
+  posix_madvise((void *)data, size, POSIX_MADV_SEQUENTIAL);
 
-  if (arg_count == 0) {
+  // files with a null byte near the start are taken as binary and skipped
+  bool more = true;
+  if (!memchr(data, '\0', size < GREP_BINARY_CHECK ? size : GREP_BINARY_CHECK)) {
+    more = grep_lines(search, path, data, size);
+  }
+
+  munmap((void *)data, size);
+  return more;
+}
+
+static bool grep_visit(struct rqshell_walk_entry const *entry, void *user) {
+  struct fs_search *search = user;
+  if (!entry->is_file) {
+    // directories, links, FIFOs and devices are not searched
+    return !rqshell_job_cancelled(search->job);
+  }
+  return grep_file(search, entry->path);
+}
+
+void rqshell_command_grep(struct rqshell_job *job, int argc,
+                          char const **argv) {
+  if (argc < 2 || argv[1][0] == '\0') {
+    rqshell_println("Error: grep: expects a pattern");
     return;
-  } else if (arg_count > 1) {
-    rqshell_println("Error: cd: too many arguments parsed to cd");
+  } else if (argc > 3) {
+    rqshell_println("Error: grep: too many arguments");
     return;
-  } else if (arg_count == 1) {
-    const char *c = rqshell_arg_iter_next(&iter);
-    if (strcmp(c, "~") == 0) {
-      rqshell_printlnf("%s", home);
-      ChangeDirectory(home);
-    } else if (DirectoryExists(c)) {
-      rqshell_printlnf("%s", c);
-      ChangeDirectory(c);
-    } else {
-      rqshell_printlnf("Error: %s: No such directory", c);
+  }
+
+  char const *path = argc > 2 ? argv[2] : ".";
+  struct fs_search search;
+  fs_search_init(&search, job, argv[1]);
+
+  if (FileExists(path) && !DirectoryExists(path)) {
+    grep_file(&search, path);
+  } else {
+    struct rqshell_walk walk = {
+        .visit = grep_visit,
+        .thread_start = fs_search_thread_start,
+        .user = &search,
+    };
+    if (!rqshell_walk(path, &walk)) {
+      rqshell_printlnf("Error: grep: %s: no such file or directory", path);
+      return;
     }
   }
+  fs_search_report(&search, "grep");
+}
+
+static bool du_visit(struct rqshell_walk_entry const *entry, void *user) {
+  struct fs_search *search = user;
+  if (entry->is_dir) {
+    atomic_fetch_add_explicit(&search->dirs, 1, memory_order_relaxed);
+  } else {
+    atomic_fetch_add_explicit(&search->files, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&search->bytes, entry->size, memory_order_relaxed);
+  }
+  return !rqshell_job_cancelled(search->job);
+}
+
+static void du_format_size(char *out, size_t cap, unsigned long long bytes) {
+  static char const *units[] = {"B", "KiB", "MiB", "GiB", "TiB"};
+  double size = (double)bytes;
+  int unit = 0;
+  while (size >= 1024.0 && unit < 4) {
+    size /= 1024.0;
+    unit++;
+  }
+
+  if (unit == 0) {
+    snprintf(out, cap, "%llu B", bytes);
+  } else {
+    snprintf(out, cap, "%.1f %s", size, units[unit]);
+  }
+}
+
+void rqshell_command_du(struct rqshell_job *job, int argc, char const **argv) {
+  char const *dot[] = {"du", "."};
+  if (argc == 1) {
+    argc = 2;
+    argv = dot;
+  }
+
+  for (int i = 1; i < argc && !rqshell_job_cancelled(job); ++i) {
+    struct fs_search search;
+    fs_search_init(&search, job, NULL);
+    struct rqshell_walk walk = {
+        .visit = du_visit,
+        .thread_start = fs_search_thread_start,
+        .user = &search,
+        .stat = true,
+    };
+
+    if (!rqshell_walk(argv[i], &walk)) {
+      rqshell_printlnf("Error: du: %s: No such directory", argv[i]);
+      continue;
+    }
+    if (rqshell_job_cancelled(job)) {
+      return;
+    }
+
+    char size[32];
+    du_format_size(size, sizeof(size), atomic_load(&search.bytes));
+    rqshell_printlnf("%-10s %s  (%llu files, %llu directories)", size, argv[i],
+                     atomic_load(&search.files), atomic_load(&search.dirs));
+  }
 }
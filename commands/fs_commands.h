@@ -3,10 +3,78 @@
 #ifndef _HEADER_FILE_rqshell_fs_commands_20230315185510_
 #define _HEADER_FILE_rqshell_fs_commands_20230315185510_
 
+#include "../rqshell.h"
+
+/*
+ * pwd
+ * cd [dir | ~]
+ * Handlers for rqshell_register_argv.
+ */
+void rqshell_command_pwd_argv(int argc, char const **argv);
+
+void rqshell_command_cd_argv(int argc, char const **argv);
+
+/*
+ * ls [-n <limit>] [--page <page>] [path or glob]...
+ * Runs as a task, reading the directories a few entries at a time.
+ */
+enum rqshell_task_status rqshell_command_ls_task(struct rqshell_task *task,
+                                                 int argc, char const **argv);
+
+/*
+ * The same commands as raw argument line handlers for rqshell_register,
+ * splitting the line themselves. ls lists everything in one go this way.
+ */
 void rqshell_command_pwd(int cs, char const *cc);
 
 void rqshell_command_ls(int cs, char const *cc);
 
 void rqshell_command_cd(int cs, char const *cc);
 
+/*
+ * cat <file>...
+ * head [-n <lines>] <file>...
+ * tail [-n <lines>] <file>...
+ * Run as tasks, showing the mapped files a few lines at a time.
+ */
+enum rqshell_task_status rqshell_command_cat(struct rqshell_task *task,
+                                             int argc, char const **argv);
+
+enum rqshell_task_status rqshell_command_head(struct rqshell_task *task,
+                                              int argc, char const **argv);
+
+enum rqshell_task_status rqshell_command_tail(struct rqshell_task *task,
+                                              int argc, char const **argv);
+
+/*
+ * find [dir] [-name <glob>]
+ * Lists the paths below dir, or those whose name matches the glob.
+ */
+void rqshell_command_find(struct rqshell_job *job, int argc, char const **argv);
+
+/*
+ * grep <text> [path]
+ * Lists the lines containing text in the file, or in the files below the
+ * directory. Binary files are skipped.
+ */
+void rqshell_command_grep(struct rqshell_job *job, int argc, char const **argv);
+
+/*
+ * du [dir]...
+ * Totals the size of the files below each directory.
+ */
+void rqshell_command_du(struct rqshell_job *job, int argc, char const **argv);
+
+/*
+ * Completers for rqshell_register_completer, offering the files and
+ * directories, or only the directories, that start with the word.
+ * Directory listings are cached and only read again once the directory's
+ * modification time changes.
+ */
+void rqshell_complete_path(struct rqshell_completion *c, int argc,
+                           char const **argv);
+
+void rqshell_complete_directory(struct rqshell_completion *c, int argc,
+                                char const **argv);
+
 #endif
\ No newline at end of file
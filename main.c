@@ -10,12 +10,58 @@ void echo_command(int len, char const *c) {
     rqshell_printlnf("%*.s\n", len, c);
 }
 
+// A command that runs over several frames, counting to the given number
+// without ever taking more than the console's time budget per frame
+enum rqshell_task_status count_task(struct rqshell_task *task, int argc, char const **argv) {
+  static long i, n;
+  if (task->cancelled) {
+    return RQSHELL_TASK_DONE;
+  }
+
+  if (!task->state) {
+    i = 0;
+    n = argc > 1 ? atol(argv[1]) : 100000000;
+    task->state = &i;
+  }
+
+  while (i < n && !rqshell_task_should_yield(task)) {
+    i++;
+  }
+  task->progress = (float)i / (float)n;
+
+  if (i >= n) {
+    rqshell_printlnf("counted to %ld", n);
+    return RQSHELL_TASK_DONE;
+  }
+  return RQSHELL_TASK_RUNNING;
+}
+
+
+// Sums the numbers up to the given one on a worker thread
+void sum_command(struct rqshell_job *job, int argc, char const **argv) {
+  long long n = argc > 1 ? atoll(argv[1]) : 1000000000;
+  long long sum = 0;
+  for (long long i = 1; i <= n; ++i) {
+    if ((i & 0xfffff) == 0 && rqshell_job_cancelled(job)) {
+      return;
+    }
+    sum += i;
+  }
+  rqshell_printlnf("sum of 1..%lld is %lld", n, sum);
+}
+
+// Game variables the console can change with set, get and toggle
+static int target_fps = 60;
+static bool show_fps = false;
+static char greeting[64] = "HELLO";
 
 int main(int argc, char **argv) {
 
   InitWindow(800, 600, "HELLO");
 
   rqshell_init();
+  rqshell_capture_raylib_log(true);
+  rqshell_set_history_file("console_history.txt");
 
   Font f = LoadFontEx("resources/DotGothic16-Regular.ttf", 18, NULL, 1024);
 
@@ -24,22 +70,71 @@ int main(int argc, char **argv) {
   // Register new commands, the first string is the prefix "command name" that is matched
   // when a user is typing a command. The second is the command function that gets executed
   // when a prefix is encountered
-  rqshell_register("pwd", rqshell_command_pwd);
-  rqshell_register("ls", rqshell_command_ls);
-  rqshell_register("cd", rqshell_command_cd);
   rqshell_register("echo", echo_command);
 
+  // Commands registered with rqshell_register_argv get their arguments already
+  // split up, like the arguments of main
+  rqshell_register_argv("pwd", rqshell_command_pwd_argv);
+  rqshell_register_argv("cd", rqshell_command_cd_argv);
+
+  // Tasks run a slice at a time each frame, and can be cancelled with ctrl+c
+  rqshell_register_task("count", count_task);
+  rqshell_register_task("ls", rqshell_command_ls_task);
+  rqshell_register_task("cat", rqshell_command_cat);
+  rqshell_register_task("head", rqshell_command_head);
+  rqshell_register_task("tail", rqshell_command_tail);
+
+  // Async commands run on a worker thread and can block without stalling the frame
+  rqshell_register_async("sum", sum_command);
+  rqshell_register_async("find", rqshell_command_find);
+  rqshell_register_async("grep", rqshell_command_grep);
+  rqshell_register_async("du", rqshell_command_du);
+
+  // Completers let tab complete the arguments of a command
+  rqshell_register_completer("cd", rqshell_complete_directory);
+  rqshell_register_completer("ls", rqshell_complete_path);
+  rqshell_register_completer("cat", rqshell_complete_path);
+  rqshell_register_completer("head", rqshell_complete_path);
+  rqshell_register_completer("tail", rqshell_complete_path);
+  rqshell_register_completer("find", rqshell_complete_directory);
+  rqshell_register_completer("grep", rqshell_complete_path);
+  rqshell_register_completer("du", rqshell_complete_directory);
+
+  // Variables are bound to the game's own memory, the game reads them as usual
+  rqshell_cvar_bind_int("target_fps", &target_fps);
+  rqshell_cvar_bind_bool("show_fps", &show_fps);
+  rqshell_cvar_bind_string("greeting", greeting, sizeof(greeting));
+
+  int fps = 0;
+
   while (!WindowShouldClose()) {
+    // Scopes timed with rqshell_prof_begin and rqshell_prof_end are shown by prof
+    rqshell_prof_begin("console update");
     rqshell_update();
+    rqshell_prof_end();
+
+    if (fps != target_fps) {
+      fps = target_fps;
+      SetTargetFPS(fps);
+    }
 
     BeginDrawing();
     ClearBackground(WHITE);
 
+    DrawText(greeting, 20, GetScreenHeight() - 40, 20, DARKGRAY);
+    if (show_fps) {
+      DrawFPS(GetScreenWidth() - 100, GetScreenHeight() - 40);
+    }
+
+    rqshell_prof_begin("console render");
     rqshell_render();
+    rqshell_prof_end();
 
     EndDrawing();
   }
 
+  rqshell_close();
   UnloadFont(f);
+  CloseWindow();
   return 0;
 }
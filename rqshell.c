@@ -1,13 +1,38 @@
 #include "rqshell.h"
+#include "rqshell_args.h"
+#include "rqshell_clock.h"
+#include "rqshell_cmdtable.h"
 #include "rqshell_config.h"
+#include "rqshell_cvars.h"
+#include "rqshell_deferred.h"
+#include "rqshell_history.h"
+#include "rqshell_lines.h"
+#include "rqshell_prof.h"
+#include "rqshell_queue.h"
+#include "rqshell_trie.h"
+#include "rqshell_trigram.h"
+#include "rqshell_workers.h"
 #include <raylib.h>
 #include <raymath.h>
+#include <math.h>
 #include <stdarg.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+struct rqshell_completion {
+  char const *word; // the word being completed, not null terminated
+  int word_length;
+  char common[LINE_SIZE]; // longest prefix shared by the candidates
+  int common_length;
+  unsigned count;
+  char const *shown[COMPLETION_SHOWN]; // the first candidates, for listing
+  unsigned shown_count;
+  char arena[COMPLETION_ARENA]; // copies of the shown candidates
+  int arena_used;
+};
+
 static inline bool is_white_space(char c) {
   return (c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f');
 }
@@ -16,11 +41,37 @@ extern void rqshell_command_clear(int len, char const *c);
 
 extern void rqshell_command_exit(int len, char const *c);
 
+extern void rqshell_command_help(int len, char const *c);
+
+extern void rqshell_command_jobs(int len, char const *c);
+
+extern void rqshell_command_set(int argc, char const **argv);
+
+extern void rqshell_command_get(int argc, char const **argv);
+
+extern void rqshell_command_toggle(int argc, char const **argv);
+
+extern void rqshell_command_list(int argc, char const **argv);
+
+extern void rqshell_complete_cvar(struct rqshell_completion *c, int argc,
+                                  char const **argv);
+
+extern void rqshell_command_watch(int argc, char const **argv);
+
+extern void rqshell_command_unwatch(int argc, char const **argv);
+
+extern void rqshell_command_prof(int argc, char const **argv);
+
+extern void rqshell_command_cmdstats(int argc, char const **argv);
+
+extern void rqshell_command_shellstats(int argc, char const **argv);
+
 static void rqshell_raylib_logging(int logLevel, const char *text,
                                    va_list args);
 
 struct console {
-  char text[N_LINES][LINE_SIZE];
+  char prompt[LINE_SIZE];
+  struct rqshell_lines text;
   Rectangle window;
   Camera2D view_port;
 
@@ -31,12 +82,15 @@ struct console {
   Color background_color;
   Color font_color;
 
+  struct rqshell_cmdtable commands;
+  struct rqshell_trie names; // the command names, for completion
+  struct rqshell_completion completion;
+  struct rqshell_cvars cvars;
+
   struct {
-    char prefix_buffer[LINE_SIZE];
-    const char *key[N_DECISIONS];
-    void (*value[N_DECISIONS])(int, char const *);
-    int used;
-  } decisions;
+    char line[LINE_SIZE]; // tokenized copy of the command line
+    char const *argv[N_ARGS + 1];
+  } args;
 
   struct {
     bool down;
@@ -45,11 +99,62 @@ struct console {
   } backspace;
 
   struct {
-    char buffer[N_LINES][LINE_SIZE];
+    struct rqshell_history entries;
     unsigned index;
-    unsigned used;
   } history;
 
+  struct {
+    bool active;
+    bool failed; // no entry older than the match contains the query
+    char query[LINE_SIZE];
+    int length;
+    long match; // number of the matching entry in index, -1 if none
+    struct rqshell_trigram_index const *index; // the history being searched
+    struct rqshell_trigram_search state;
+  } search;
+
+  struct {
+    bool active;
+    bool filter; // show only the matching lines
+    char query[LINE_SIZE];
+    int length;
+    unsigned long long *hits; // numbers of the matching lines, oldest first
+    size_t count;
+    size_t cap;
+    size_t current; // hit the view is on
+    unsigned long long scanned; // newest line number searched
+    float offset; // view port offset before the search, restored on cancel
+  } find;
+
+  struct {
+    struct {
+      char name[WATCH_NAME_SIZE];
+      unsigned interval; // frames between samples
+      unsigned countdown; // frames until the next sample
+      char value[LINE_SIZE]; // the last sampled value
+    } entries[WATCH_LIMIT];
+    unsigned count;
+    RenderTexture2D target; // the pinned lines, drawn when a value changes
+    bool dirty;
+  } watch;
+
+  struct {
+    bool graph; // draw the frame time graph
+    float frames[PROF_FRAMES]; // milliseconds of the latest frames
+    unsigned next; // slot of the next frame time
+
+    // what the console itself cost in the same frames
+    struct {
+      float update_ms; // not counting command handlers
+      float render_ms;
+      unsigned draws;
+      unsigned glyphs;
+    } cost[PROF_FRAMES];
+    unsigned long long updates; // frames recorded so far
+    unsigned long long handler_ns; // command handler time of this update
+    bool updating; // inside rqshell_update, the newest frame is not done
+  } prof;
+
   struct {
     float percent;
     float timer;
@@ -74,14 +179,127 @@ struct console {
     bool on;
   } cursor;
 
+  struct {
+    struct rqshell_task state;
+    enum rqshell_task_status (*step)(struct rqshell_task *, int,
+                                     char const **); // null when no task runs
+    char const *name;
+    int argc; // the arguments are kept in args until the task is done
+    double budget; // seconds a step may take
+    unsigned long long elapsed_ns; // time spent in the steps so far
+    unsigned steps;
+    bool timed; // report the time when done, see the time keyword
+  } task;
+
+  struct {
+    bool active; // count the output of the command being timed
+    unsigned lines;
+    unsigned long long bytes;
+    unsigned long long ns; // time spent adding the lines
+  } timing;
+
+  struct rqshell_workers workers; // runs the async commands
+
+  struct {
+    unsigned count; // times the newest line was printed in a row
+    int length; // length of the newest line without the repeat count
+  } repeat;
+
+  struct {
+    struct rqshell_queue queue; // lines posted from any thread
+    enum rqshell_overflow policy;
+    size_t reported; // dropped lines already reported in the scrollback
+  } posted;
+
+  struct {
+    char batch[LOG_BATCH_SIZE]; // null terminated lines waiting for the update step
+    int used;
+    int level; // least important log level that is shown
+  } raylib_log;
+
+  struct {
+    RenderTexture2D target; // the scrollback as drawn at full console height
+    bool dirty; // true when the target no longer matches the scrollback
+  } cache;
+
   char show_buffer[LINE_SIZE];
 } g_console;
 
+static inline void rqshell_push_textn(char const *text, int len) {
+  rqshell_lines_pushn(&g_console.text, text, len);
+  g_console.cache.dirty = true;
+  g_console.repeat.count = 0; // only printed lines may be repeated
+}
+
+static inline void rqshell_push_text(char const *text) {
+  rqshell_push_textn(text, (int)strnlen(text, LINE_SIZE - 1));
+}
+
+static inline void rqshell_append_textn(char const *text, int len);
+
+// Print a line, but if it repeats the newest line only bump the repeat count
+// shown at the end of the newest line.
+static inline void rqshell_print_textn(char const *text, int len) {
+  if (len > LINE_SIZE - 1) {
+    len = LINE_SIZE - 1;
+  }
+
+  struct rqshell_job *job = rqshell_workers_current(&g_console.workers);
+  if (job) {
+    // printed by an async command, hand the line to the update thread
+    unsigned long long start = job->timed ? rqshell_now_ns() : 0;
+    while (!rqshell_queue_try_push(&g_console.posted.queue, text, len) &&
+           !atomic_load_explicit(&job->cancelled, memory_order_relaxed)) {
+      rqshell_workers_nap();
+    }
+    if (job->timed) {
+      atomic_fetch_add_explicit(&job->printed_lines, 1, memory_order_relaxed);
+      atomic_fetch_add_explicit(&job->printed_bytes, len,
+                                memory_order_relaxed);
+      atomic_fetch_add_explicit(&job->print_ns, rqshell_now_ns() - start,
+                                memory_order_relaxed);
+    }
+    return;
+  }
+
+  if (!g_console.timing.active) {
+    rqshell_append_textn(text, len);
+    return;
+  }
+  unsigned long long start = rqshell_now_ns();
+  rqshell_append_textn(text, len);
+  g_console.timing.lines++;
+  g_console.timing.bytes += len;
+  g_console.timing.ns += rqshell_now_ns() - start;
+}
+
+// Add a line to the scrollback, or count a repeat of the newest line.
+static inline void rqshell_append_textn(char const *text, int len) {
+  // blank lines are left alone, they are usually spacing
+  if (len == 0 || g_console.repeat.count == 0 ||
+      len != g_console.repeat.length ||
+      rqshell_lines_count(&g_console.text) == 0 ||
+      memcmp(rqshell_lines_get(&g_console.text, 0), text, len) != 0) {
+    rqshell_push_textn(text, len);
+    g_console.repeat.count = 1;
+    g_console.repeat.length = len;
+    return;
+  }
+
+  char line[LINE_SIZE];
+  int written = snprintf(line, LINE_SIZE, "%.*s (x%u)", len, text,
+                         ++g_console.repeat.count);
+  rqshell_lines_pop(&g_console.text);
+  rqshell_lines_pushn(&g_console.text, line,
+                      written < LINE_SIZE ? written : LINE_SIZE - 1);
+  g_console.cache.dirty = true;
+}
+
 static inline void rqshell_move_left(int byte_size) {
   if (g_console.cursor.byteoffset <= 0) {
     return;
   }
-  char *prompt_line = &(g_console.text[0][0]);
+  char *prompt_line = g_console.prompt;
 
   if (byte_size == 0) {
     GetCodepointPrevious(prompt_line + g_console.cursor.byteoffset, &byte_size);
@@ -91,10 +309,10 @@ static inline void rqshell_move_left(int byte_size) {
 }
 
 static inline void rqshell_move_right(int byte_size) {
-  if (g_console.cursor.byteoffset >= strlen(g_console.text[0])) {
+  if (g_console.cursor.byteoffset >= (int)strlen(g_console.prompt)) {
     return;
   }
-  char *prompt_line = &(g_console.text[0][0]);
+  char *prompt_line = g_console.prompt;
 
   if (byte_size == 0) {
     GetCodepointNext(prompt_line + g_console.cursor.byteoffset, &byte_size);
@@ -107,7 +325,7 @@ static inline void rqshell_del_char(struct console *c) {
   if (g_console.cursor.byteoffset <= 0) {
     return;
   }
-  char *prompt_line = &(c->text[0][0]);
+  char *prompt_line = c->prompt;
 
   char *deletion_point = prompt_line + g_console.cursor.byteoffset;
   int rest_size = strlen(deletion_point) + 1;
@@ -124,7 +342,7 @@ static inline void rqshell_put_char(struct console *c, int cha) {
   if (g_console.cursor.byteoffset >= LINE_SIZE) {
     return;
   }
-  char *prompt_line = &(c->text[0][0]);
+  char *prompt_line = c->prompt;
 
   char *insertion_point = prompt_line + g_console.cursor.byteoffset;
   int rest_size = strlen(insertion_point) + 1;
@@ -138,21 +356,9 @@ static inline void rqshell_put_char(struct console *c, int cha) {
   rqshell_move_right(utfsize);
 }
 
-static inline void rqshell_shift_up(char bufs[N_LINES][LINE_SIZE], int nbufs) {
-  char n[LINE_SIZE], b[LINE_SIZE];
-
-  memcpy(n, *bufs, sizeof(n));
-  for (int i = 1; i < (nbufs - 1); ++i) {
-    memcpy(b, bufs[i], sizeof(b));
-    memcpy(bufs[i], n, sizeof(bufs[i]));
-    memcpy(n, b, sizeof(n));
-  }
-}
-
 void rqshell_init() {
-  for (int i = 0; i < N_LINES; ++i) {
-    memset(g_console.text + i, '\0', LINE_SIZE);
-  }
+  memset(g_console.prompt, '\0', LINE_SIZE);
+  g_console.text = rqshell_lines_init(SCROLLBACK_LIMIT);
 
   g_console.window = (Rectangle){
       .width = (float)GetScreenWidth(),
@@ -160,11 +366,7 @@ void rqshell_init() {
       .y = 0.f,
   };
 
-  g_console.decisions.used = 0;
-  for (int i = 0; i < N_DECISIONS; ++i) {
-    g_console.decisions.value[i] = NULL;
-    g_console.decisions.key[i] = NULL;
-  }
+  g_console.commands = (struct rqshell_cmdtable){0};
 
   g_console.font_size = 14.0f;
   g_console.activation_key = KEY_F3;
@@ -172,7 +374,8 @@ void rqshell_init() {
   g_console.backspace.down = false;
   g_console.backspace.timer = 0.f;
   g_console.backspace.timeout = 0.5f;
-  g_console.history.index = g_console.history.used = 0;
+  g_console.history.index = 0;
+  g_console.history.entries = rqshell_history_init(HISTORY_LIMIT);
   g_console.background_color = (Color){.r = 0, .b = 0, .g = 0, .a = 210};
   g_console.font_color = (Color){.r = 0, .b = 0, .g = 255, .a = 255};
 
@@ -192,309 +395,1670 @@ void rqshell_init() {
       .zoom = 1.f,
   };
 
+  g_console.cache.target = (RenderTexture2D){0};
+  g_console.cache.dirty = true;
+
+  g_console.task.step = NULL;
+  g_console.task.budget = TASK_BUDGET_MS / 1000.0;
+
+  rqshell_workers_init(&g_console.workers);
+
+  g_console.repeat.count = 0;
+  g_console.repeat.length = 0;
+
+  g_console.raylib_log.used = 0;
+  g_console.raylib_log.level = LOG_INFO;
+
+  rqshell_queue_init(&g_console.posted.queue);
+  g_console.posted.policy = RQSHELL_OVERFLOW_COUNT;
+  g_console.posted.reported = 0;
+
   rqshell_register("exit", rqshell_command_exit);
   rqshell_register("clear", rqshell_command_clear);
+  rqshell_register("help", rqshell_command_help);
+  rqshell_register("jobs", rqshell_command_jobs);
+
+  rqshell_register_argv("set", rqshell_command_set);
+  rqshell_register_argv("get", rqshell_command_get);
+  rqshell_register_argv("toggle", rqshell_command_toggle);
+  rqshell_register_argv("list", rqshell_command_list);
+  rqshell_register_completer("set", rqshell_complete_cvar);
+  rqshell_register_completer("get", rqshell_complete_cvar);
+  rqshell_register_completer("toggle", rqshell_complete_cvar);
+
+  rqshell_register_argv("watch", rqshell_command_watch);
+  rqshell_register_argv("unwatch", rqshell_command_unwatch);
+  rqshell_register_completer("watch", rqshell_complete_cvar);
+  rqshell_register_completer("unwatch", rqshell_complete_cvar);
+
+  rqshell_register_argv("prof", rqshell_command_prof);
+  rqshell_register_argv("cmdstats", rqshell_command_cmdstats);
+  rqshell_register_argv("shellstats", rqshell_command_shellstats);
 }
 
 void rqshell_println(char const *blah) {
-  memcpy(g_console.text[0], blah, sizeof(g_console.text[0]));
-  rqshell_shift_up(g_console.text, N_LINES);
+  rqshell_print_textn(blah, (int)strnlen(blah, LINE_SIZE - 1));
+}
+
+void rqshell_printlnn(char const *text, int len) {
+  rqshell_print_textn(text, len < 0 ? 0 : len);
 }
 
 void rqshell_printlnf(char const *format, ...) {
+  char line[LINE_SIZE];
   va_list args;
   va_start(args, format);
 
-  int written = vsnprintf(g_console.text[0], LINE_SIZE, format, args);
+  int written = vsnprintf(line, LINE_SIZE, format, args);
+  va_end(args);
+
   if (written < 0) {
     rqshell_println("Fatal error: failed to write to console");
     return;
   }
 
-  va_end(args);
-
-  rqshell_shift_up(g_console.text, N_LINES);
+  rqshell_print_textn(line, written < LINE_SIZE ? written : LINE_SIZE - 1);
 }
 
-void rqshell_register(const char *name, void (*f)(int, char const *)) {
-  int j = g_console.decisions.used;
-  g_console.decisions.key[j] = name;
-  g_console.decisions.value[j] = f;
-  g_console.decisions.used++;
-}
+void rqshell_printlnf_deferred(char const *format, ...) {
+  char record[LINE_SIZE];
+  va_list args, eager;
+  va_start(args, format);
+  va_copy(eager, args);
 
-int rqshell_parse_prefix(char *buffer, int buffer_length) {
-  char *prompt_line = g_console.text[0];
-  int len = (int)strlen(prompt_line);
-  if (len == 0) {
-    return -1; // empty input
+  int size = -1;
+  if (!rqshell_workers_current(&g_console.workers)) {
+    size = rqshell_deferred_capture(record, LINE_SIZE, format, args);
   }
-
-  int prefix_end = 0, prefix_start = 0, prefix_len = 0;
-
-  for (; prefix_start < len; ++prefix_start) {
-    if (!is_white_space(prompt_line[prefix_start])) {
-      break;
+  if (size < 0) {
+    // unsupported conversion, a record too big or not on the update thread,
+    // format it right away
+    char line[LINE_SIZE];
+    int written = vsnprintf(line, LINE_SIZE, format, eager);
+    if (written >= 0) {
+      rqshell_print_textn(line, written < LINE_SIZE ? written : LINE_SIZE - 1);
     }
+  } else {
+    rqshell_lines_push_deferred(&g_console.text, record, size);
+    g_console.cache.dirty = true;
+    g_console.repeat.count = 0;
   }
 
-  for (prefix_end = prefix_start; prefix_end < len; ++prefix_end) {
-    if (is_white_space(prompt_line[prefix_end])) {
-      break;
-    }
-  }
+  va_end(eager);
+  va_end(args);
+}
 
-  prefix_len = (prefix_end - prefix_start);
+bool rqshell_rate_limit_allow(struct rqshell_rate_limit *limit,
+                              float per_second, float burst) {
+  double now = GetTime();
+  double tokens = limit->tokens + (now - limit->last) * per_second;
 
-  memset(buffer, '\0', LINE_SIZE);
-  if (memcpy(buffer, prompt_line + prefix_start, prefix_len) == NULL) {
-    return -1;
-  }
-  buffer[buffer_length - 1] = '\0';
+  limit->tokens = tokens < burst ? tokens : burst;
+  limit->last = now;
 
-  return prefix_end;
+  if (limit->tokens < 1.0) {
+    limit->dropped++;
+    return false;
+  }
+  limit->tokens -= 1.0;
+  return true;
 }
 
-// scan command line and find out which command to run
-void rqshell_scan() {
-  char *prompt_line = g_console.history.buffer[0];
-  int len = (int)strlen(prompt_line);
-  if (len == 0) {
-    return; // empty input
+static struct rqshell_command *rqshell_add_command(const char *name) {
+  if (rqshell_cmdtable_find(&g_console.commands, name, (int)strlen(name))) {
+    rqshell_printlnf("Error: %s: command is already registered", name);
+    return NULL;
   }
 
-  int prefix_end =
-      rqshell_parse_prefix(g_console.decisions.prefix_buffer, LINE_SIZE);
-  if (prefix_end == -1) {
-    rqshell_printlnf("Error: No such command");
-    return;
+  struct rqshell_command *command =
+      rqshell_cmdtable_insert(&g_console.commands, name);
+  if (!command) {
+    rqshell_printlnf("Error: %s: could not register command", name);
+  } else if (!rqshell_trie_insert(&g_console.names, name)) {
+    rqshell_printlnf("Error: %s: command will not be completed", name);
   }
+  return command;
+}
 
-  int prefix_len = (int)strlen(g_console.decisions.prefix_buffer);
+bool rqshell_post(char const *text) {
+  return rqshell_queue_push(&g_console.posted.queue, text, (int)strlen(text));
+}
 
-  for (int decision_index = 0; decision_index < g_console.decisions.used;
-       ++decision_index) {
+bool rqshell_postf(char const *format, ...) {
+  va_list args;
+  va_start(args, format);
+  bool queued = rqshell_queue_vpushf(&g_console.posted.queue, format, args);
+  va_end(args);
+  return queued;
+}
 
-    const char *key = g_console.decisions.key[decision_index];
-    if (strlen(key) < prefix_len) {
-      continue;
-    }
+void rqshell_set_overflow_policy(enum rqshell_overflow policy) {
+  g_console.posted.policy = policy;
+}
 
-    if (strcmp(g_console.decisions.prefix_buffer, key) == 0) {
-      int start_of_args = prefix_end;
-      for (; start_of_args < len && is_white_space(prompt_line[start_of_args]);
-           start_of_args++)
-        ;
+size_t rqshell_get_dropped_count() {
+  return atomic_load_explicit(&g_console.posted.queue.dropped,
+                              memory_order_relaxed);
+}
 
-      (*g_console.decisions.value[decision_index])((len - start_of_args),
-                                                   prompt_line + start_of_args);
-      return;
-    }
+// Move the lines posted by other threads into the scrollback. At most one
+// queue worth of lines is moved, so busy producers cannot stall the frame.
+static inline void rqshell_drain_posted() {
+  struct rqshell_queue *queue = &g_console.posted.queue;
+  struct rqshell_queue_slot *slot;
+
+  for (int i = 0; i < POST_QUEUE_SIZE && (slot = rqshell_queue_peek(queue));
+       ++i) {
+    rqshell_print_textn(slot->text, slot->length);
+    rqshell_queue_pop(queue);
   }
 
-  rqshell_printlnf("Error: %s: No such command",
-                   g_console.decisions.prefix_buffer);
+  size_t dropped = rqshell_get_dropped_count();
+  if (dropped != g_console.posted.reported &&
+      g_console.posted.policy == RQSHELL_OVERFLOW_COUNT) {
+    rqshell_printlnf("[%zu posted lines dropped]",
+                     dropped - g_console.posted.reported);
+  }
+  g_console.posted.reported = dropped;
 }
 
-static inline void rqshell_update_animation() {
-  if (IsKeyPressed(g_console.activation_key)) {
-    if (g_console.opening_animation.state == CONSOLE_CLOSED) {
-      g_console.opening_animation.state = CONSOLE_OPENING;
-    } else if (g_console.opening_animation.state == CONSOLE_OPENED) {
-      g_console.opening_animation.state = CONSOLE_CLOSING;
-    }
-  }
+// Move the batched raylib log lines into the scrollback.
+static void rqshell_flush_raylib_log() {
+  char const *line = g_console.raylib_log.batch;
+  char const *end = line + g_console.raylib_log.used;
 
-  if (g_console.opening_animation.state == CONSOLE_CLOSING ||
-      g_console.opening_animation.state == CONSOLE_OPENING) {
-    g_console.opening_animation.timer += GetFrameTime();
-    g_console.window.height =
-        Lerp(0.f, GetScreenHeight() / 3.f, g_console.opening_animation.percent);
+  while (line < end) {
+    int len = (int)strlen(line);
+    rqshell_print_textn(line, len);
+    line += len + 1;
   }
+  g_console.raylib_log.used = 0;
+}
 
-  if (g_console.opening_animation.state == CONSOLE_OPENING &&
-      g_console.opening_animation.timer > 0.001f) {
-    g_console.opening_animation.percent =
-        Clamp(g_console.opening_animation.percent + 0.01f, 0.f, 1.f);
-    g_console.opening_animation.timer = 0.f;
-    if (g_console.opening_animation.percent >= 1.f) {
-      g_console.opening_animation.state = CONSOLE_OPENED;
-    }
-  } else if (g_console.opening_animation.state == CONSOLE_CLOSING &&
-             g_console.opening_animation.timer > 0.001f) {
-    g_console.opening_animation.percent =
-        Clamp(g_console.opening_animation.percent - 0.01f, 0.f, 1.f);
-    g_console.opening_animation.timer = 0.f;
-    if (g_console.opening_animation.percent <= 0.f) {
-      g_console.opening_animation.state = CONSOLE_CLOSED;
-    }
+static char const *rqshell_log_tag(int log_level) {
+  switch (log_level) {
+  case LOG_TRACE:
+    return "[TRACE] ";
+  case LOG_DEBUG:
+    return "[DEBUG] ";
+  case LOG_INFO:
+    return "[INFO] ";
+  case LOG_WARNING:
+    return "[WARNING] ";
+  case LOG_ERROR:
+    return "[ERROR] ";
+  case LOG_FATAL:
+    return "[FATAL] ";
+  default:
+    return "";
   }
 }
 
-static inline void rqshell_handle_backspace() {
-  if (IsKeyPressed(KEY_BACKSPACE)) {
-    g_console.backspace.down = true;
-    rqshell_del_char(&g_console);
+// raylib trace log callback. Lines are formatted into the batch buffer and
+// only reach the scrollback at the next update step, or when the batch is full.
+static void rqshell_raylib_logging(int logLevel, const char *text,
+                                   va_list args) {
+  if (logLevel < g_console.raylib_log.level) {
+    return;
   }
 
-  if (IsKeyReleased(KEY_BACKSPACE)) {
-    g_console.backspace.down = false;
-    g_console.backspace.timer = 0.f;
-    g_console.backspace.timeout = BACKSPACE_DELETE_FIRST;
+  if (LOG_BATCH_SIZE - g_console.raylib_log.used < LINE_SIZE) {
+    rqshell_flush_raylib_log();
   }
 
-  if (g_console.backspace.down) {
-    g_console.backspace.timer += GetFrameTime();
-    int prompt_len = (int)strlen(g_console.text[0]);
-    if (prompt_len > 0 &&
-        g_console.backspace.timer > g_console.backspace.timeout) {
-
-      rqshell_del_char(&g_console);
+  char *line = g_console.raylib_log.batch + g_console.raylib_log.used;
+  char const *tag = rqshell_log_tag(logLevel);
+  int len = (int)strlen(tag);
+  memcpy(line, tag, len);
 
-      g_console.backspace.timer = 0.f;
-      g_console.backspace.timeout = BACKSPACE_DELETE;
-    } else if (prompt_len == 0) {
-      g_console.backspace.down = false;
-    }
+  int written = vsnprintf(line + len, LINE_SIZE - len, text, args);
+  if (written > 0) {
+    len += written < LINE_SIZE - len ? written : LINE_SIZE - len - 1;
   }
-}
+  line[len] = '\0';
 
-static inline void rqshell_handle_cursor_move() {
+  g_console.raylib_log.used += len + 1;
+}
 
-  int prompt_len = (int)strlen(g_console.text[0]);
+void rqshell_capture_raylib_log(bool enable) {
+  SetTraceLogCallback(enable ? rqshell_raylib_logging : NULL);
+}
 
-  if (IsKeyPressed(KEY_LEFT)) {
-    g_console.cursor.move_timer = 0.f;
-    g_console.cursor.direction = CURSOR_LEFT_MOVE;
-    g_console.cursor.timeout = CURSOR_MOVE_FIRST;
-    rqshell_move_left(0);
+void rqshell_set_log_level(int log_level) {
+  g_console.raylib_log.level = log_level;
+}
 
-  } else if (IsKeyPressed(KEY_RIGHT)) {
-    g_console.cursor.move_timer = 0.f;
-    g_console.cursor.direction = CURSOR_RIGHT_MOVE;
-    g_console.cursor.timeout = CURSOR_MOVE_FIRST;
-    rqshell_move_right(0);
+bool rqshell_register(const char *name, void (*f)(int, char const *)) {
+  struct rqshell_command *command = rqshell_add_command(name);
+  if (!command) {
+    return false;
   }
+  command->handler = f;
+  return true;
+}
 
-  if (IsKeyReleased(KEY_LEFT) || IsKeyReleased(KEY_RIGHT)) {
-    g_console.cursor.direction = CURSOR_NO_MOVE;
-    g_console.cursor.move_timer = 0.f;
+bool rqshell_register_argv(const char *name, void (*f)(int, char const **)) {
+  struct rqshell_command *command = rqshell_add_command(name);
+  if (!command) {
+    return false;
   }
+  command->argv_handler = f;
+  return true;
+}
 
-  switch (g_console.cursor.direction) {
-  case CURSOR_LEFT_MOVE:
-    g_console.cursor.move_timer += GetFrameTime();
-    if (g_console.cursor.move_timer > g_console.cursor.timeout) {
-      rqshell_move_left(0);
-      g_console.cursor.move_timer = 0.f;
-      g_console.cursor.timeout = CURSOR_MOVE;
-    }
-    break;
-  case CURSOR_RIGHT_MOVE:
-    g_console.cursor.move_timer += GetFrameTime();
-    if (g_console.cursor.move_timer > g_console.cursor.timeout) {
-      rqshell_move_right(0);
-      g_console.cursor.move_timer = 0.f;
-      g_console.cursor.timeout = CURSOR_MOVE;
-    }
-    break;
-  default:
-    break;
+bool rqshell_register_task(const char *name,
+                           enum rqshell_task_status (*step)(struct rqshell_task *,
+                                                            int, char const **)) {
+  struct rqshell_command *command = rqshell_add_command(name);
+  if (!command) {
+    return false;
   }
+  command->task = step;
+  return true;
 }
 
-static inline void rqshell_handle_enter() {
-  if (IsKeyPressed(KEY_ENTER)) {
-    if (strcmp(g_console.history.buffer[0], g_console.text[0]) != 0) {
-      memcpy(g_console.history.buffer[0], g_console.text[0],
-             sizeof(g_console.history.buffer[0]));
-      rqshell_shift_up(g_console.history.buffer, N_LINES);
-      g_console.history.used = g_console.history.used < N_LINES
-                                   ? g_console.history.used + 1
-                                   : (N_LINES - 1);
-    }
-
-    rqshell_shift_up(g_console.text, N_LINES);
-    rqshell_scan();
-    memset(g_console.text[0], '\0', LINE_SIZE);
+bool rqshell_task_should_yield(struct rqshell_task const *task) {
+  return GetTime() >= task->deadline;
+}
 
-    g_console.history.index = g_console.cursor.byteoffset = 0;
-  }
+void rqshell_set_task_budget(float milliseconds) {
+  g_console.task.budget = milliseconds / 1000.0;
 }
 
-static inline void rqshell_handle_history() {
-  if (IsKeyPressed(KEY_UP)) {
-    g_console.history.index = g_console.history.index < g_console.history.used
-                                  ? g_console.history.index + 1
-                                  : g_console.history.used;
-    memcpy(g_console.text[0], g_console.history.buffer[g_console.history.index],
-           sizeof(g_console.text[0]));
-    g_console.cursor.byteoffset = (int)strlen(g_console.text[0]);
-  } else if (IsKeyPressed(KEY_DOWN)) {
-    g_console.history.index =
-        g_console.history.index > 0 ? g_console.history.index - 1 : 0;
-    memcpy(g_console.text[0], g_console.history.buffer[g_console.history.index],
-           sizeof(g_console.text[0]));
-    g_console.cursor.byteoffset = (int)strlen(g_console.text[0]);
+// Add a handler call to the latency of the command with the given name.
+// Commands are looked up again, as a handler may have registered commands
+// and moved the table.
+static void rqshell_record_call(char const *name, unsigned long long ns) {
+  struct rqshell_command *command =
+      rqshell_cmdtable_find(&g_console.commands, name, (int)strlen(name));
+  if (!command) {
+    return;
+  }
+  command->calls++;
+  command->total_ns += ns;
+  if (ns > command->max_ns) {
+    command->max_ns = ns;
   }
 }
 
-static inline void rqshell_handle_cursor() {
+static void rqshell_report_time(char const *name, unsigned long long ns,
+                                char const *how, unsigned lines,
+                                unsigned long long bytes,
+                                unsigned long long print_ns) {
+  rqshell_printlnf("time: %s: %.3f ms%s, output %u lines, %llu bytes in %.3f ms",
+                   name, ns / 1e6, how, lines, bytes, print_ns / 1e6);
+}
 
-  if (g_console.cursor.direction == CURSOR_NO_MOVE) {
-    g_console.cursor.blink_timer += GetFrameTime();
-    if (g_console.cursor.blink_timer >= 0.5f) {
-      g_console.cursor.on = !g_console.cursor.on;
-      g_console.cursor.blink_timer = 0.f;
-    }
+// Run one step of the current task, if any.
+static void rqshell_step_task() {
+  if (!g_console.task.step) {
+    return;
   }
 
-  memcpy(g_console.show_buffer, g_console.text[0], LINE_SIZE);
-
-  if (g_console.cursor.on || g_console.cursor.direction != CURSOR_NO_MOVE) {
-    int utf8_size = 0;
-    GetCodepointNext(g_console.show_buffer + g_console.cursor.byteoffset,
-                     &utf8_size);
-
-    if (utf8_size > 1) {
-      memmove(g_console.show_buffer + g_console.cursor.byteoffset +
-                  (utf8_size - 1),
-              g_console.show_buffer + g_console.cursor.byteoffset + utf8_size,
-              strlen(g_console.show_buffer + g_console.cursor.byteoffset +
-                     utf8_size) +
-                  1);
+  struct rqshell_task *task = &g_console.task.state;
+  task->deadline = GetTime() + g_console.task.budget;
+
+  g_console.timing.active = g_console.task.timed;
+  unsigned long long start = rqshell_now_ns();
+  enum rqshell_task_status status =
+      g_console.task.step(task, g_console.task.argc, g_console.args.argv);
+  unsigned long long ns = rqshell_now_ns() - start;
+  g_console.task.elapsed_ns += ns;
+  g_console.prof.handler_ns += ns;
+  g_console.task.steps++;
+  g_console.timing.active = false;
+
+  if (status == RQSHELL_TASK_DONE || task->cancelled) {
+    g_console.task.step = NULL;
+    rqshell_record_call(g_console.task.name, g_console.task.elapsed_ns);
+    if (g_console.task.timed) {
+      char steps[32];
+      snprintf(steps, sizeof(steps), " over %u step%s", g_console.task.steps,
+               g_console.task.steps == 1 ? "" : "s");
+      rqshell_report_time(g_console.task.name, g_console.task.elapsed_ns,
+                          steps, g_console.timing.lines,
+                          g_console.timing.bytes, g_console.timing.ns);
     }
-
-    g_console.show_buffer[g_console.cursor.byteoffset] = '_';
   }
 }
 
-static inline void rqshell_handle_paste() {
-  if (!IsKeyDown(KEY_LEFT_CONTROL) || !IsKeyPressed(KEY_V)) {
+static void rqshell_cancel_task() {
+  if (!g_console.task.step) {
     return;
   }
+  g_console.task.state.cancelled = true;
+  rqshell_step_task();
+  rqshell_printlnf("^C %s: cancelled", g_console.task.name);
+}
 
-  const char *clip = GetClipboardText();
-
-  if (!clip) {
-    return;
+bool rqshell_register_async(const char *name,
+                            void (*handler)(struct rqshell_job *, int,
+                                            char const **)) {
+  struct rqshell_command *command = rqshell_add_command(name);
+  if (!command) {
+    return false;
   }
+  command->async = handler;
+  return true;
+}
 
-  const char *line_end = strpbrk(clip, "\n");
-  const char *line_start = clip;
-  int line_size = 0;
+bool rqshell_job_cancelled(struct rqshell_job const *job) {
+  return atomic_load_explicit(&job->cancelled, memory_order_relaxed);
+}
 
-  while (line_end && line_start) {
-    line_size = (line_end - line_start) -
-                ((line_end - clip) >= 2 && line_end[-1] == '\r' ? 1 : 0);
+void rqshell_job_attach(struct rqshell_job *job) {
+  rqshell_workers_set_current(&g_console.workers, job);
+}
+
+struct foreach_job {
+  void (*f)(char const *name, bool running, void *user);
+  void *user;
+};
+
+static void rqshell_foreach_job_visit(struct rqshell_job const *job,
+                                      void *user) {
+  struct foreach_job *visit = user;
+  visit->f(job->name, job->state == RQSHELL_JOB_RUNNING, visit->user);
+}
+
+void rqshell_foreach_job(void (*f)(char const *name, bool running, void *user),
+                         void *user) {
+  struct foreach_job visit = {.f = f, .user = user};
+  rqshell_workers_foreach(&g_console.workers, rqshell_foreach_job_visit,
+                          &visit);
+}
+
+// Report the async commands that finished. The lines a command printed were
+// queued before it finished, so they are drained before its status.
+static void rqshell_reap_jobs() {
+  struct rqshell_job *job;
+  while ((job = rqshell_workers_next_done(&g_console.workers))) {
+    rqshell_drain_posted();
+    bool started = job->elapsed_ns > 0 || !rqshell_job_cancelled(job);
+    if (started) {
+      rqshell_record_call(job->name, job->elapsed_ns);
+    }
+    if (rqshell_job_cancelled(job)) {
+      rqshell_printlnf("^C %s: cancelled", job->name);
+    }
+    if (job->timed && started) {
+      // the job is done, so every thread that printed for it has finished
+      rqshell_report_time(
+          job->name, job->elapsed_ns, " on a worker",
+          atomic_load_explicit(&job->printed_lines, memory_order_relaxed),
+          atomic_load_explicit(&job->printed_bytes, memory_order_relaxed),
+          atomic_load_explicit(&job->print_ns, memory_order_relaxed));
+    }
+    rqshell_workers_release(&g_console.workers, job);
+  }
+}
+
+// Start an async command with its own copy of the command line.
+static void rqshell_start_job(struct rqshell_command const *command,
+                              char const *line, int len, bool timed) {
+  struct rqshell_job *job = rqshell_workers_acquire(&g_console.workers);
+  if (!job) {
+    rqshell_printlnf("Error: %s: too many commands running", command->name);
+    return;
+  }
+
+  memcpy(job->line, line, len + 1);
+  int argc = rqshell_arg_split(job->line, len, job->argv, N_ARGS);
+  if (argc < 0) {
+    rqshell_printlnf("Error: %s: malformed arguments", command->name);
+    return;
+  } else if (argc > N_ARGS) {
+    rqshell_printlnf("Error: %s: too many arguments", command->name);
+    return;
+  }
+
+  job->argv[argc] = NULL;
+  job->argc = argc;
+  job->name = command->name;
+  job->handler = command->async;
+  job->timed = timed;
+  atomic_store_explicit(&job->printed_lines, 0, memory_order_relaxed);
+  atomic_store_explicit(&job->printed_bytes, 0, memory_order_relaxed);
+  atomic_store_explicit(&job->print_ns, 0, memory_order_relaxed);
+
+  if (!rqshell_workers_submit(&g_console.workers, job)) {
+    rqshell_printlnf("Error: %s: could not start a worker thread",
+                     command->name);
+  }
+}
+
+bool rqshell_register_completer(const char *name,
+                                void (*completer)(struct rqshell_completion *,
+                                                  int, char const **)) {
+  struct rqshell_command *command =
+      rqshell_cmdtable_find(&g_console.commands, name, (int)strlen(name));
+  if (!command) {
+    rqshell_printlnf("Error: %s: command is not registered", name);
+    return false;
+  }
+  command->complete = completer;
+  return true;
+}
+
+static bool rqshell_cvar_bind(char const *name, enum rqshell_cvar_type type,
+                              void *value, size_t size) {
+  struct rqshell_cvar *cvar = rqshell_cvars_insert(&g_console.cvars, name);
+  if (!cvar) {
+    rqshell_printlnf("Error: %s: variable is already bound", name);
+    return false;
+  }
+  cvar->type = type;
+  cvar->value = value;
+  cvar->size = size;
+  return true;
+}
+
+bool rqshell_cvar_bind_float(char const *name, float *value) {
+  return rqshell_cvar_bind(name, RQSHELL_CVAR_FLOAT, value, sizeof(*value));
+}
+
+bool rqshell_cvar_bind_int(char const *name, int *value) {
+  return rqshell_cvar_bind(name, RQSHELL_CVAR_INT, value, sizeof(*value));
+}
+
+bool rqshell_cvar_bind_bool(char const *name, bool *value) {
+  return rqshell_cvar_bind(name, RQSHELL_CVAR_BOOL, value, sizeof(*value));
+}
+
+bool rqshell_cvar_bind_string(char const *name, char *value, size_t size) {
+  if (size == 0) {
+    rqshell_printlnf("Error: %s: string variable has no room", name);
+    return false;
+  }
+  return rqshell_cvar_bind(name, RQSHELL_CVAR_STRING, value, size);
+}
+
+static struct rqshell_cvar *rqshell_cvar_lookup(char const *name) {
+  struct rqshell_cvar *cvar =
+      rqshell_cvars_find(&g_console.cvars, name, (int)strlen(name));
+  if (!cvar) {
+    rqshell_printlnf("Error: %s: no such variable", name);
+  }
+  return cvar;
+}
+
+bool rqshell_cvar_set(char const *name, char const *text) {
+  struct rqshell_cvar *cvar = rqshell_cvar_lookup(name);
+  if (!cvar) {
+    return false;
+  }
+  if (!rqshell_cvar_parse(cvar, text)) {
+    if (cvar->type == RQSHELL_CVAR_STRING) {
+      rqshell_printlnf("Error: %s: value is longer than %zu characters", name,
+                       cvar->size - 1);
+    } else {
+      rqshell_printlnf("Error: %s: '%s' is not a valid %s", name, text,
+                       rqshell_cvar_type_name(cvar->type));
+    }
+    return false;
+  }
+  return true;
+}
+
+bool rqshell_cvar_toggle(char const *name) {
+  struct rqshell_cvar *cvar = rqshell_cvar_lookup(name);
+  if (!cvar) {
+    return false;
+  }
+  if (cvar->type != RQSHELL_CVAR_BOOL) {
+    rqshell_printlnf("Error: %s: only bool variables can be toggled", name);
+    return false;
+  }
+  bool *value = cvar->value;
+  *value = !*value;
+  return true;
+}
+
+char const *rqshell_cvar_get(char const *name) {
+  struct rqshell_cvar *cvar =
+      rqshell_cvars_find(&g_console.cvars, name, (int)strlen(name));
+  return cvar ? rqshell_cvar_format(cvar) : NULL;
+}
+
+void rqshell_foreach_cvar(void (*f)(char const *name, char const *type,
+                                    char const *value, void *user),
+                          void *user) {
+  unsigned count = 0;
+  struct rqshell_cvar const *const *sorted =
+      rqshell_cvars_sorted(&g_console.cvars, &count);
+
+  for (unsigned i = 0; i < count; ++i) {
+    // formatting only updates the cached text of the variable
+    struct rqshell_cvar *cvar = (struct rqshell_cvar *)sorted[i];
+    f(cvar->name, rqshell_cvar_type_name(cvar->type),
+      rqshell_cvar_format(cvar), user);
+  }
+}
+
+void rqshell_foreach_command(void (*f)(char const *name, void *user),
+                             void *user) {
+  unsigned count = 0;
+  struct rqshell_command const *const *sorted =
+      rqshell_cmdtable_sorted(&g_console.commands, &count);
+
+  for (unsigned i = 0; i < count; ++i) {
+    f(sorted[i]->name, user);
+  }
+}
+
+// Whether a word is the time keyword. A registered command named time takes
+// precedence, so registering one does not leave it unreachable.
+static inline bool rqshell_is_time_keyword(char const *word, int len) {
+  return len == 4 && memcmp(word, "time", 4) == 0 &&
+         !rqshell_cmdtable_find(&g_console.commands, word, len);
+}
+
+// Start counting the output of a command run with the time keyword.
+static void rqshell_begin_timing(bool timed) {
+  if (timed) {
+    memset(&g_console.timing, 0, sizeof(g_console.timing));
+    g_console.timing.active = true;
+  }
+}
+
+// Record the latency of a command that returned, reporting it if timed.
+static void rqshell_end_timing(bool timed, char const *name,
+                               unsigned long long ns) {
+  rqshell_record_call(name, ns);
+  g_console.prof.handler_ns += ns;
+  if (timed) {
+    g_console.timing.active = false;
+    rqshell_report_time(name, ns, "", g_console.timing.lines,
+                        g_console.timing.bytes, g_console.timing.ns);
+  }
+}
+
+// Run a command line, timing the handler. The line must be null terminated
+// at len.
+static void rqshell_run_line(char const *prompt_line, int len, bool timed) {
+  int prefix_start = 0, prefix_end = 0;
+
+  for (; prefix_start < len; ++prefix_start) {
+    if (!is_white_space(prompt_line[prefix_start])) {
+      break;
+    }
+  }
+
+  for (prefix_end = prefix_start; prefix_end < len; ++prefix_end) {
+    if (is_white_space(prompt_line[prefix_end])) {
+      break;
+    }
+  }
+
+  int prefix_len = prefix_end - prefix_start;
+  if (prefix_len == 0) {
+    if (timed) {
+      rqshell_println("Error: time: expects a command to time");
+    }
+    return; // empty input
+  }
+
+  if (rqshell_is_time_keyword(prompt_line + prefix_start, prefix_len)) {
+    rqshell_run_line(prompt_line + prefix_end, len - prefix_end, true);
+    return;
+  }
+
+  struct rqshell_command *command = rqshell_cmdtable_find(
+      &g_console.commands, prompt_line + prefix_start, prefix_len);
+  if (!command) {
+    rqshell_printlnf("Error: %.*s: No such command", prefix_len,
+                     prompt_line + prefix_start);
+    return;
+  }
+
+  if (command->async) {
+    rqshell_start_job(command, prompt_line, len, timed);
+    return;
+  }
+
+  if (command->argv_handler || command->task) {
+    memcpy(g_console.args.line, prompt_line, len + 1);
+    int argc = rqshell_arg_split(g_console.args.line, len, g_console.args.argv,
+                                 N_ARGS);
+    if (argc < 0) {
+      rqshell_printlnf("Error: %s: malformed arguments", command->name);
+      return;
+    } else if (argc > N_ARGS) {
+      rqshell_printlnf("Error: %s: too many arguments", command->name);
+      return;
+    }
+
+    g_console.args.argv[argc] = NULL;
+
+    if (command->task) {
+      g_console.task.step = command->task;
+      g_console.task.name = command->name;
+      g_console.task.argc = argc;
+      g_console.task.state = (struct rqshell_task){.progress = -1.f};
+      g_console.task.elapsed_ns = 0;
+      g_console.task.steps = 0;
+      g_console.task.timed = timed;
+      memset(&g_console.timing, 0, sizeof(g_console.timing));
+      rqshell_step_task();
+    } else {
+      char const *name = command->name;
+      rqshell_begin_timing(timed);
+      unsigned long long start = rqshell_now_ns();
+      command->argv_handler(argc, g_console.args.argv);
+      rqshell_end_timing(timed, name, rqshell_now_ns() - start);
+    }
+    return;
+  }
+
+  int start_of_args = prefix_end;
+  for (; start_of_args < len && is_white_space(prompt_line[start_of_args]);
+       start_of_args++)
+    ;
+
+  char const *name = command->name;
+  rqshell_begin_timing(timed);
+  unsigned long long start = rqshell_now_ns();
+  command->handler((len - start_of_args), prompt_line + start_of_args);
+  rqshell_end_timing(timed, name, rqshell_now_ns() - start);
+}
+
+// scan command line and find out which command to run
+void rqshell_scan() {
+  rqshell_run_line(g_console.prompt, (int)strlen(g_console.prompt), false);
+}
+
+void rqshell_foreach_command_stats(
+    void (*f)(char const *name, struct rqshell_command_stats const *stats,
+              void *user),
+    void *user) {
+  unsigned count = 0;
+  struct rqshell_command const *const *sorted =
+      rqshell_cmdtable_sorted(&g_console.commands, &count);
+
+  for (unsigned i = 0; i < count; ++i) {
+    if (sorted[i]->calls == 0) {
+      continue;
+    }
+    struct rqshell_command_stats stats = {
+        .calls = sorted[i]->calls,
+        .total_ms = sorted[i]->total_ns / 1e6,
+        .max_ms = sorted[i]->max_ns / 1e6,
+    };
+    f(sorted[i]->name, &stats, user);
+  }
+}
+
+void rqshell_reset_command_stats(void) {
+  unsigned count = 0;
+  struct rqshell_command const *const *sorted =
+      rqshell_cmdtable_sorted(&g_console.commands, &count);
+
+  for (unsigned i = 0; i < count; ++i) {
+    struct rqshell_command *command = (struct rqshell_command *)sorted[i];
+    command->calls = command->total_ns = command->max_ns = 0;
+  }
+}
+
+static inline void rqshell_update_animation() {
+  if (IsKeyPressed(g_console.activation_key)) {
+    if (g_console.opening_animation.state == CONSOLE_CLOSED) {
+      g_console.opening_animation.state = CONSOLE_OPENING;
+    } else if (g_console.opening_animation.state == CONSOLE_OPENED) {
+      g_console.opening_animation.state = CONSOLE_CLOSING;
+    }
+  }
+
+  if (g_console.opening_animation.state == CONSOLE_CLOSING ||
+      g_console.opening_animation.state == CONSOLE_OPENING) {
+    g_console.opening_animation.timer += GetFrameTime();
+    g_console.window.height =
+        Lerp(0.f, GetScreenHeight() / 3.f, g_console.opening_animation.percent);
+  }
+
+  if (g_console.opening_animation.state == CONSOLE_OPENING &&
+      g_console.opening_animation.timer > 0.001f) {
+    g_console.opening_animation.percent =
+        Clamp(g_console.opening_animation.percent + 0.01f, 0.f, 1.f);
+    g_console.opening_animation.timer = 0.f;
+    if (g_console.opening_animation.percent >= 1.f) {
+      g_console.opening_animation.state = CONSOLE_OPENED;
+    }
+  } else if (g_console.opening_animation.state == CONSOLE_CLOSING &&
+             g_console.opening_animation.timer > 0.001f) {
+    g_console.opening_animation.percent =
+        Clamp(g_console.opening_animation.percent - 0.01f, 0.f, 1.f);
+    g_console.opening_animation.timer = 0.f;
+    if (g_console.opening_animation.percent <= 0.f) {
+      g_console.opening_animation.state = CONSOLE_CLOSED;
+    }
+  }
+}
+
+static inline void rqshell_handle_backspace() {
+  if (IsKeyPressed(KEY_BACKSPACE)) {
+    g_console.backspace.down = true;
+    rqshell_del_char(&g_console);
+  }
+
+  if (IsKeyReleased(KEY_BACKSPACE)) {
+    g_console.backspace.down = false;
+    g_console.backspace.timer = 0.f;
+    g_console.backspace.timeout = BACKSPACE_DELETE_FIRST;
+  }
+
+  if (g_console.backspace.down) {
+    g_console.backspace.timer += GetFrameTime();
+    int prompt_len = (int)strlen(g_console.prompt);
+    if (prompt_len > 0 &&
+        g_console.backspace.timer > g_console.backspace.timeout) {
+
+      rqshell_del_char(&g_console);
+
+      g_console.backspace.timer = 0.f;
+      g_console.backspace.timeout = BACKSPACE_DELETE;
+    } else if (prompt_len == 0) {
+      g_console.backspace.down = false;
+    }
+  }
+}
+
+static inline void rqshell_handle_cursor_move() {
+
+  if (IsKeyPressed(KEY_LEFT)) {
+    g_console.cursor.move_timer = 0.f;
+    g_console.cursor.direction = CURSOR_LEFT_MOVE;
+    g_console.cursor.timeout = CURSOR_MOVE_FIRST;
+    rqshell_move_left(0);
+
+  } else if (IsKeyPressed(KEY_RIGHT)) {
+    g_console.cursor.move_timer = 0.f;
+    g_console.cursor.direction = CURSOR_RIGHT_MOVE;
+    g_console.cursor.timeout = CURSOR_MOVE_FIRST;
+    rqshell_move_right(0);
+  }
+
+  if (IsKeyReleased(KEY_LEFT) || IsKeyReleased(KEY_RIGHT)) {
+    g_console.cursor.direction = CURSOR_NO_MOVE;
+    g_console.cursor.move_timer = 0.f;
+  }
+
+  switch (g_console.cursor.direction) {
+  case CURSOR_LEFT_MOVE:
+    g_console.cursor.move_timer += GetFrameTime();
+    if (g_console.cursor.move_timer > g_console.cursor.timeout) {
+      rqshell_move_left(0);
+      g_console.cursor.move_timer = 0.f;
+      g_console.cursor.timeout = CURSOR_MOVE;
+    }
+    break;
+  case CURSOR_RIGHT_MOVE:
+    g_console.cursor.move_timer += GetFrameTime();
+    if (g_console.cursor.move_timer > g_console.cursor.timeout) {
+      rqshell_move_right(0);
+      g_console.cursor.move_timer = 0.f;
+      g_console.cursor.timeout = CURSOR_MOVE;
+    }
+    break;
+  default:
+    break;
+  }
+}
+
+static inline void rqshell_handle_enter() {
+  if (IsKeyPressed(KEY_ENTER)) {
+    rqshell_history_add(&g_console.history.entries, g_console.prompt);
+
+    rqshell_push_text(g_console.prompt);
+    rqshell_scan();
+    memset(g_console.prompt, '\0', LINE_SIZE);
+
+    g_console.history.index = g_console.cursor.byteoffset = 0;
+  }
+}
+
+// Show a history entry in the prompt. Index 0 is the empty prompt,
+// index 1 the most recent command. Returns false if there is no such entry.
+static inline bool rqshell_show_history(unsigned index) {
+  size_t len = 0;
+  char const *entry = "";
+  if (index > 0) {
+    entry = rqshell_history_get(&g_console.history.entries, index - 1, &len);
+    if (!entry) {
+      return false;
+    }
+  }
+
+  if (len > LINE_SIZE - 1) {
+    len = LINE_SIZE - 1;
+  }
+  memset(g_console.prompt, '\0', LINE_SIZE);
+  memcpy(g_console.prompt, entry, len);
+  g_console.cursor.byteoffset = (int)strlen(g_console.prompt);
+  return true;
+}
+
+static inline void rqshell_handle_history() {
+  if (IsKeyPressed(KEY_UP)) {
+    if (rqshell_show_history(g_console.history.index + 1)) {
+      g_console.history.index++;
+    }
+  } else if (IsKeyPressed(KEY_DOWN)) {
+    g_console.history.index =
+        g_console.history.index > 0 ? g_console.history.index - 1 : 0;
+    rqshell_show_history(g_console.history.index);
+  }
+}
+
+// Narrow the search to the current query and show the newest match.
+static void rqshell_search_update() {
+  rqshell_trigram_search_set(&g_console.search.state, g_console.search.index,
+                             g_console.search.query, g_console.search.length);
+  g_console.search.match = rqshell_trigram_search_next(
+      &g_console.search.state, g_console.search.index,
+      g_console.search.index->count);
+  g_console.search.failed =
+      g_console.search.match < 0 && g_console.search.length > 0;
+}
+
+// Show the next older match, skipping entries that repeat the shown one.
+static void rqshell_search_older() {
+  long match = g_console.search.match;
+  if (match < 0) {
+    return;
+  }
+
+  size_t shown_len;
+  char const *shown =
+      rqshell_trigram_text(g_console.search.index, match, &shown_len);
+
+  long older = match;
+  for (;;) {
+    older = rqshell_trigram_search_next(&g_console.search.state,
+                                        g_console.search.index, older);
+    if (older < 0) {
+      g_console.search.failed = true;
+      return;
+    }
+
+    size_t len;
+    char const *text = rqshell_trigram_text(g_console.search.index, older, &len);
+    if (len != shown_len || memcmp(text, shown, len) != 0) {
+      break;
+    }
+  }
+  g_console.search.match = older;
+}
+
+// Put the match in the prompt and end the search.
+static void rqshell_search_accept() {
+  g_console.search.active = false;
+  if (g_console.search.match < 0) {
+    return;
+  }
+
+  size_t len;
+  char const *text = rqshell_trigram_text(g_console.search.index,
+                                          g_console.search.match, &len);
+  if (len > LINE_SIZE - 1) {
+    len = LINE_SIZE - 1;
+  }
+  memset(g_console.prompt, '\0', LINE_SIZE);
+  memcpy(g_console.prompt, text, len);
+  g_console.cursor.byteoffset = (int)strlen(g_console.prompt);
+  g_console.history.index = 0;
+}
+
+// Ctrl+R searches the history backwards for the typed text, like readline.
+// Each character typed narrows the matches, ctrl+r again shows an older
+// match, enter runs the match, arrow keys keep it for editing, and
+// ctrl+g or ctrl+c leave the prompt as it was.
+// Returns true while the search takes the keyboard input.
+static inline bool rqshell_handle_search() {
+  bool control =
+      IsKeyDown(KEY_LEFT_CONTROL) || IsKeyDown(KEY_RIGHT_CONTROL);
+
+  if (!g_console.search.active) {
+    if (!control || !IsKeyPressed(KEY_R)) {
+      return false;
+    }
+    g_console.search.active = true;
+    g_console.search.index = rqshell_history_index(&g_console.history.entries);
+    g_console.search.length = 0;
+    g_console.search.query[0] = '\0';
+    rqshell_search_update();
+    return true;
+  }
+
+  if (control && IsKeyPressed(KEY_R)) {
+    rqshell_search_older();
+  } else if (control && (IsKeyPressed(KEY_G) || IsKeyPressed(KEY_C))) {
+    g_console.search.active = false;
+  } else if (IsKeyPressed(KEY_ENTER)) {
+    rqshell_search_accept();
+    return false; // let the enter run the command
+  } else if (IsKeyPressed(KEY_LEFT) || IsKeyPressed(KEY_RIGHT) ||
+             IsKeyPressed(KEY_UP) || IsKeyPressed(KEY_DOWN) ||
+             IsKeyPressed(KEY_TAB)) {
+    rqshell_search_accept();
+  } else if (IsKeyPressed(KEY_BACKSPACE) && g_console.search.length > 0) {
+    int length = g_console.search.length - 1;
+    while (length > 0 && (g_console.search.query[length] & 0xC0) == 0x80) {
+      length--; // remove a whole UTF-8 character
+    }
+    g_console.search.query[length] = '\0';
+    g_console.search.length = length;
+    rqshell_search_update();
+  } else {
+    bool typed = false;
+    for (int c; (c = GetCharPressed()) != 0;) {
+      int size = 0;
+      char const *point = CodepointToUTF8(c, &size);
+      if (g_console.search.length + size < LINE_SIZE) {
+        memcpy(g_console.search.query + g_console.search.length, point, size);
+        g_console.search.length += size;
+        g_console.search.query[g_console.search.length] = '\0';
+        typed = true;
+      }
+    }
+    if (typed) {
+      rqshell_search_update();
+    }
+  }
+  return true;
+}
+
+// Watched variables are pinned in rows above the prompt, and the scrollback
+// is drawn that many rows higher.
+static inline unsigned rqshell_pinned_rows() { return g_console.watch.count; }
+
+static int rqshell_watch_find(char const *name) {
+  for (unsigned i = 0; i < g_console.watch.count; ++i) {
+    if (strcmp(g_console.watch.entries[i].name, name) == 0) {
+      return (int)i;
+    }
+  }
+  return -1;
+}
+
+bool rqshell_watch(char const *name, unsigned interval) {
+  if (!rqshell_cvar_get(name)) {
+    rqshell_printlnf("Error: %s: no such variable", name);
+    return false;
+  }
+  if (strlen(name) >= WATCH_NAME_SIZE) {
+    rqshell_printlnf("Error: %s: name is too long to watch", name);
+    return false;
+  }
+
+  int at = rqshell_watch_find(name);
+  if (at < 0) {
+    if (g_console.watch.count == WATCH_LIMIT) {
+      rqshell_printlnf("Error: %s: at most %d variables can be watched", name,
+                       WATCH_LIMIT);
+      return false;
+    }
+    at = (int)g_console.watch.count++;
+    strcpy(g_console.watch.entries[at].name, name);
+    g_console.watch.entries[at].value[0] = '\0';
+    g_console.cache.dirty = true; // the scrollback moves up a row
+  }
+  g_console.watch.entries[at].interval = interval > 0 ? interval : 1;
+  g_console.watch.entries[at].countdown = 0; // sample on the next update
+  g_console.watch.dirty = true;
+  return true;
+}
+
+bool rqshell_unwatch(char const *name) {
+  if (!name) {
+    g_console.watch.count = 0;
+  } else {
+    int at = rqshell_watch_find(name);
+    if (at < 0) {
+      return false;
+    }
+    g_console.watch.count--;
+    memmove(g_console.watch.entries + at, g_console.watch.entries + at + 1,
+            (g_console.watch.count - at) * sizeof(*g_console.watch.entries));
+  }
+  g_console.watch.dirty = true;
+  g_console.cache.dirty = true;
+  return true;
+}
+
+void rqshell_foreach_watch(void (*f)(char const *name, unsigned interval,
+                                     char const *value, void *user),
+                           void *user) {
+  for (unsigned i = 0; i < g_console.watch.count; ++i) {
+    f(g_console.watch.entries[i].name, g_console.watch.entries[i].interval,
+      g_console.watch.entries[i].value, user);
+  }
+}
+
+// Sample the watched variables that are due, noting if any value changed.
+static void rqshell_sample_watches() {
+  for (unsigned i = 0; i < g_console.watch.count; ++i) {
+    if (g_console.watch.entries[i].countdown > 0) {
+      g_console.watch.entries[i].countdown--;
+      continue;
+    }
+    g_console.watch.entries[i].countdown =
+        g_console.watch.entries[i].interval - 1;
+
+    char const *value = rqshell_cvar_get(g_console.watch.entries[i].name);
+    char *shown = g_console.watch.entries[i].value;
+    if (strcmp(shown, value) != 0) {
+      snprintf(shown, LINE_SIZE, "%s", value);
+      g_console.watch.dirty = true;
+    }
+  }
+}
+
+// Slot of the frame being updated and rendered.
+static inline unsigned rqshell_frame_slot() {
+  return (g_console.prof.next + PROF_FRAMES - 1) % PROF_FRAMES;
+}
+
+// Count a draw call for the console's own cost, with the glyphs of its text
+// when it draws text.
+static inline void rqshell_count_draw(char const *text) {
+  unsigned slot = rqshell_frame_slot();
+  g_console.prof.cost[slot].draws++;
+  for (; text && *text; ++text) {
+    // spaces and the continuation bytes of UTF-8 sequences draw nothing
+    if (*text != ' ' && ((unsigned char)*text & 0xC0) != 0x80) {
+      g_console.prof.cost[slot].glyphs++;
+    }
+  }
+}
+
+// Draw the pinned lines into their own target, sized for the lines watched.
+static void rqshell_redraw_watches() {
+  float line_height = g_console.font_size + 2.f;
+  int width = GetScreenWidth();
+  int height = (int)ceilf(g_console.watch.count * line_height);
+
+  if (g_console.watch.target.id != 0 &&
+      (g_console.watch.target.texture.width != width ||
+       g_console.watch.target.texture.height != height)) {
+    UnloadRenderTexture(g_console.watch.target);
+    g_console.watch.target = (RenderTexture2D){0};
+  }
+  if (g_console.watch.count == 0) {
+    g_console.watch.dirty = false;
+    return;
+  }
+  if (g_console.watch.target.id == 0) {
+    g_console.watch.target = LoadRenderTexture(width, height);
+  }
+
+  char line[LINE_SIZE];
+  BeginTextureMode(g_console.watch.target);
+  ClearBackground(BLANK);
+  Color background = g_console.font_color;
+  background.a = 30;
+  rqshell_count_draw(NULL);
+  DrawRectangle(0, 0, width, height, background);
+  for (unsigned i = 0; i < g_console.watch.count; ++i) {
+    snprintf(line, LINE_SIZE, "%s: %s", g_console.watch.entries[i].name,
+             g_console.watch.entries[i].value);
+    rqshell_count_draw(line);
+    DrawTextEx(g_console.font, line, (Vector2){.x = 0, .y = i * line_height},
+               g_console.font_size, 1.2f, g_console.font_color);
+  }
+  EndTextureMode();
+
+  g_console.watch.dirty = false;
+}
+
+// Scrollback search. Typing '/' at an empty prompt searches the scrollback
+// for the text typed after it. Hits are kept by line number, so new lines
+// only need searching once and evicted lines drop off the front.
+
+// Whether only the matching lines are shown.
+static inline bool rqshell_filtering() {
+  return g_console.find.active && g_console.find.filter &&
+         g_console.find.length > 0;
+}
+
+// Number of scrollback rows drawn.
+static inline unsigned rqshell_row_count() {
+  return rqshell_filtering() ? (unsigned)g_console.find.count
+                             : rqshell_lines_count(&g_console.text);
+}
+
+// Line number of a hit, as an age in the scrollback.
+static inline unsigned rqshell_hit_age(size_t hit) {
+  return (unsigned)(rqshell_lines_newest(&g_console.text) -
+                    g_console.find.hits[hit]);
+}
+
+// Text of a scrollback row, where row 0 is the bottom row.
+static inline char const *rqshell_row_text(unsigned row) {
+  if (rqshell_filtering()) {
+    if (row >= g_console.find.count) {
+      return "";
+    }
+    return rqshell_lines_get(&g_console.text,
+                             rqshell_hit_age(g_console.find.count - 1 - row));
+  }
+  return rqshell_lines_get(&g_console.text, row);
+}
+
+static void rqshell_find_add_hit(unsigned long long number, void *user) {
+  if (g_console.find.count == g_console.find.cap) {
+    size_t cap = g_console.find.cap ? g_console.find.cap * 2 : 256;
+    unsigned long long *hits =
+        realloc(g_console.find.hits, cap * sizeof(*hits));
+    if (!hits) {
+      return;
+    }
+    g_console.find.hits = hits;
+    g_console.find.cap = cap;
+  }
+  g_console.find.hits[g_console.find.count++] = number;
+}
+
+// Move the view port so the current hit is in the middle of the pane.
+static void rqshell_find_show(size_t hit) {
+  if (g_console.find.count == 0) {
+    return;
+  }
+  g_console.find.current = hit;
+
+  unsigned row = rqshell_filtering()
+                     ? (unsigned)(g_console.find.count - 1 - hit)
+                     : rqshell_hit_age(hit);
+  float line_height = g_console.font_size + 2.f;
+  g_console.view_port.offset.y =
+      Clamp(line_height * (row + 2 + rqshell_pinned_rows()) -
+                GetScreenHeight() / 6.f,
+            0.f,
+            rqshell_row_count() * line_height);
+  g_console.cache.dirty = true;
+}
+
+// Search the scrollback for the query again. When the query only grew,
+// the lines that matched before are the only ones that can still match.
+static void rqshell_find_update(bool narrowed) {
+  char const *query = g_console.find.query;
+  int length = g_console.find.length;
+
+  if (narrowed) {
+    size_t kept = 0;
+    for (size_t i = 0; i < g_console.find.count; ++i) {
+      char const *line = rqshell_lines_get(&g_console.text, rqshell_hit_age(i));
+      if (strstr(line, query)) {
+        g_console.find.hits[kept++] = g_console.find.hits[i];
+      }
+    }
+    g_console.find.count = kept;
+  } else {
+    g_console.find.count = 0;
+    rqshell_lines_search(&g_console.text, query, length, 0,
+                         rqshell_find_add_hit, NULL);
+  }
+  g_console.find.scanned = rqshell_lines_newest(&g_console.text);
+
+  g_console.find.current = 0;
+  if (g_console.find.count > 0) {
+    rqshell_find_show(g_console.find.count - 1);
+  } else {
+    g_console.view_port.offset.y = g_console.find.offset;
+  }
+  g_console.cache.dirty = true;
+}
+
+// Keep the hits in step with the lines added and evicted since the last step.
+static void rqshell_find_refresh() {
+  unsigned long long newest = rqshell_lines_newest(&g_console.text);
+  unsigned long long oldest = newest - rqshell_lines_count(&g_console.text) + 1;
+
+  size_t evicted = 0;
+  while (evicted < g_console.find.count &&
+         g_console.find.hits[evicted] < oldest) {
+    evicted++;
+  }
+  if (evicted > 0) {
+    g_console.find.count -= evicted;
+    memmove(g_console.find.hits, g_console.find.hits + evicted,
+            g_console.find.count * sizeof(*g_console.find.hits));
+    g_console.find.current =
+        g_console.find.current > evicted ? g_console.find.current - evicted : 0;
+    g_console.cache.dirty = true;
+  }
+
+  if (newest > g_console.find.scanned) {
+    if (g_console.find.length > 0) {
+      rqshell_lines_search(&g_console.text, g_console.find.query,
+                           g_console.find.length, g_console.find.scanned + 1,
+                           rqshell_find_add_hit, NULL);
+    }
+    g_console.find.scanned = newest;
+    g_console.cache.dirty = true;
+  }
+}
+
+static void rqshell_find_start() {
+  g_console.find.active = true;
+  g_console.find.filter = false;
+  g_console.find.length = 0;
+  g_console.find.query[0] = '\0';
+  g_console.find.count = 0;
+  g_console.find.current = 0;
+  g_console.find.scanned = rqshell_lines_newest(&g_console.text);
+  g_console.find.offset = g_console.view_port.offset.y;
+}
+
+static void rqshell_find_stop() {
+  g_console.find.active = false;
+  g_console.cache.dirty = true;
+}
+
+// Highlight the hits in a scrollback row drawn at height y, and mark the
+// row of the current hit.
+static void rqshell_highlight_hits(char const *line, unsigned row, float y) {
+  float line_height = g_console.font_size + 2.f;
+  Color color = g_console.font_color;
+
+  if (g_console.find.count > 0) {
+    size_t current = g_console.find.current;
+    unsigned current_row = rqshell_filtering()
+                               ? (unsigned)(g_console.find.count - 1 - current)
+                               : rqshell_hit_age(current);
+    if (row == current_row) {
+      color.a = 40;
+      rqshell_count_draw(NULL);
+      DrawRectangleRec((Rectangle){.x = 0,
+                                   .y = y,
+                                   .width = g_console.window.width,
+                                   .height = line_height},
+                       color);
+    }
+  }
+
+  char prefix[LINE_SIZE];
+  color.a = 100;
+  for (char const *hit = strstr(line, g_console.find.query); hit;
+       hit = strstr(hit + g_console.find.length, g_console.find.query)) {
+    int start = (int)(hit - line);
+    memcpy(prefix, line, start);
+    prefix[start] = '\0';
+    float x = start > 0 ? MeasureTextEx(g_console.font, prefix,
+                                        g_console.font_size, 1.2f).x + 1.2f
+                        : 0.f;
+    float width = MeasureTextEx(g_console.font, g_console.find.query,
+                                g_console.font_size, 1.2f).x;
+    rqshell_count_draw(NULL);
+    DrawRectangleRec(
+        (Rectangle){.x = x, .y = y, .width = width, .height = line_height},
+        color);
+  }
+}
+
+// Typing narrows the hits and jumps to the newest one, up and down step to
+// older and newer hits, tab shows only the matching lines, enter leaves the
+// view at the hit, and ctrl+g or ctrl+c go back to where the view was.
+// Returns true while the search takes the keyboard input.
+static inline bool rqshell_handle_find() {
+  if (!g_console.find.active) {
+    return false;
+  }
+  bool control =
+      IsKeyDown(KEY_LEFT_CONTROL) || IsKeyDown(KEY_RIGHT_CONTROL);
+
+  if (control && (IsKeyPressed(KEY_G) || IsKeyPressed(KEY_C))) {
+    g_console.view_port.offset.y = g_console.find.offset;
+    rqshell_find_stop();
+  } else if (IsKeyPressed(KEY_ENTER)) {
+    if (rqshell_filtering() && g_console.find.count > 0) {
+      // keep the hit in view once the other lines are back
+      g_console.find.filter = false;
+      rqshell_find_show(g_console.find.current);
+    }
+    rqshell_find_stop();
+  } else if (IsKeyPressed(KEY_UP)) {
+    if (g_console.find.current > 0) {
+      rqshell_find_show(g_console.find.current - 1);
+    }
+  } else if (IsKeyPressed(KEY_DOWN)) {
+    if (g_console.find.current + 1 < g_console.find.count) {
+      rqshell_find_show(g_console.find.current + 1);
+    }
+  } else if (IsKeyPressed(KEY_TAB)) {
+    g_console.find.filter = !g_console.find.filter;
+    rqshell_find_show(g_console.find.current);
+    g_console.cache.dirty = true;
+  } else if (IsKeyPressed(KEY_BACKSPACE)) {
+    if (g_console.find.length == 0) {
+      rqshell_find_stop();
+      return true;
+    }
+    int length = g_console.find.length - 1;
+    while (length > 0 && (g_console.find.query[length] & 0xC0) == 0x80) {
+      length--; // remove a whole UTF-8 character
+    }
+    g_console.find.query[length] = '\0';
+    g_console.find.length = length;
+    rqshell_find_update(false);
+  } else {
+    bool typed = false;
+    bool narrowed = g_console.find.length > 0;
+    for (int c; (c = GetCharPressed()) != 0;) {
+      int size = 0;
+      char const *point = CodepointToUTF8(c, &size);
+      if (g_console.find.length + size < LINE_SIZE) {
+        memcpy(g_console.find.query + g_console.find.length, point, size);
+        g_console.find.length += size;
+        g_console.find.query[g_console.find.length] = '\0';
+        typed = true;
+      }
+    }
+    if (typed) {
+      rqshell_find_update(narrowed);
+    }
+  }
+  return true;
+}
+
+static inline void rqshell_handle_cancel() {
+  bool control =
+      IsKeyDown(KEY_LEFT_CONTROL) || IsKeyDown(KEY_RIGHT_CONTROL);
+  if (g_console.search.active || g_console.find.active || !control ||
+      !IsKeyPressed(KEY_C)) {
+    return;
+  }
+
+  if (g_console.task.step) {
+    rqshell_cancel_task();
+  } else {
+    rqshell_workers_cancel_all(&g_console.workers);
+  }
+}
+
+static inline void rqshell_handle_cursor() {
+  if (g_console.task.step) {
+    // a running task replaces the prompt with its progress
+    float progress = g_console.task.state.progress;
+    if (progress >= 0.f) {
+      snprintf(g_console.show_buffer, LINE_SIZE,
+               "[%s] %3d%%  (ctrl+c to cancel)", g_console.task.name,
+               (int)(Clamp(progress, 0.f, 1.f) * 100.f));
+    } else {
+      snprintf(g_console.show_buffer, LINE_SIZE,
+               "[%s] running...  (ctrl+c to cancel)", g_console.task.name);
+    }
+    return;
+  }
+
+  if (g_console.find.active) {
+    int shown = snprintf(g_console.show_buffer, LINE_SIZE, "/%s_",
+                         g_console.find.query);
+    if (shown > 0 && shown < LINE_SIZE && g_console.find.length > 0) {
+      if (g_console.find.count > 0) {
+        snprintf(g_console.show_buffer + shown, LINE_SIZE - shown,
+                 "  (%zu of %zu%s)",
+                 g_console.find.count - g_console.find.current,
+                 g_console.find.count,
+                 g_console.find.filter ? ", filtered" : "");
+      } else {
+        snprintf(g_console.show_buffer + shown, LINE_SIZE - shown,
+                 "  (no match)");
+      }
+    }
+    return;
+  }
+
+  if (g_console.search.active) {
+    size_t len = 0;
+    char const *match = "";
+    if (g_console.search.match >= 0) {
+      match = rqshell_trigram_text(g_console.search.index,
+                                   g_console.search.match, &len);
+    }
+    snprintf(g_console.show_buffer, LINE_SIZE, "(%sreverse-i-search)`%s': %.*s",
+             g_console.search.failed ? "failed " : "", g_console.search.query,
+             (int)len, match);
+    return;
+  }
+
+  if (g_console.cursor.direction == CURSOR_NO_MOVE) {
+    g_console.cursor.blink_timer += GetFrameTime();
+    if (g_console.cursor.blink_timer >= 0.5f) {
+      g_console.cursor.on = !g_console.cursor.on;
+      g_console.cursor.blink_timer = 0.f;
+    }
+  }
+
+  memcpy(g_console.show_buffer, g_console.prompt, LINE_SIZE);
+
+  if (g_console.cursor.on || g_console.cursor.direction != CURSOR_NO_MOVE) {
+    int utf8_size = 0;
+    GetCodepointNext(g_console.show_buffer + g_console.cursor.byteoffset,
+                     &utf8_size);
+
+    if (utf8_size > 1) {
+      memmove(g_console.show_buffer + g_console.cursor.byteoffset +
+                  (utf8_size - 1),
+              g_console.show_buffer + g_console.cursor.byteoffset + utf8_size,
+              strlen(g_console.show_buffer + g_console.cursor.byteoffset +
+                     utf8_size) +
+                  1);
+    }
+
+    g_console.show_buffer[g_console.cursor.byteoffset] = '_';
+  }
+}
+
+// Keep a copy of a candidate for listing, if there is room.
+static void rqshell_completion_keep(struct rqshell_completion *c,
+                                    char const *candidate, int length) {
+  if (c->shown_count == COMPLETION_SHOWN ||
+      c->arena_used + length + 1 > COMPLETION_ARENA) {
+    return;
+  }
+  char *copy = c->arena + c->arena_used;
+  memcpy(copy, candidate, length);
+  copy[length] = '\0';
+  c->arena_used += length + 1;
+  c->shown[c->shown_count++] = copy;
+}
+
+void rqshell_completion_add(struct rqshell_completion *c,
+                            char const *candidate) {
+  int length = (int)strnlen(candidate, LINE_SIZE - 1);
+  if (length < c->word_length ||
+      memcmp(candidate, c->word, c->word_length) != 0) {
+    return;
+  }
+
+  if (c->count == 0) {
+    memcpy(c->common, candidate, length);
+    c->common_length = length;
+  } else {
+    int common = c->word_length;
+    while (common < c->common_length && common < length &&
+           c->common[common] == candidate[common]) {
+      common++;
+    }
+    c->common_length = common;
+  }
+  c->common[c->common_length] = '\0';
+
+  rqshell_completion_keep(c, candidate, length);
+  c->count++;
+}
+
+static void rqshell_completion_keep_name(char const *name, void *user) {
+  rqshell_completion_keep(user, name, (int)strlen(name));
+}
+
+// Complete a command name from the trie, which knows the number of matches
+// and how far they agree without visiting them.
+static void rqshell_complete_command(struct rqshell_completion *c) {
+  long node = rqshell_trie_find(&g_console.names, c->word, c->word_length);
+  c->count = rqshell_trie_count(&g_console.names, node);
+  if (c->count == 0) {
+    return;
+  }
+
+  memcpy(c->common, c->word, c->word_length);
+  c->common_length =
+      c->word_length + rqshell_trie_common(&g_console.names, node,
+                                           c->common + c->word_length,
+                                           LINE_SIZE - c->word_length);
+  rqshell_trie_foreach(&g_console.names, node, rqshell_completion_keep_name, c,
+                       COMPLETION_SHOWN);
+}
+
+// Complete an argument with the completer of the command, given the words
+// before the one being completed.
+static void rqshell_complete_argument(struct rqshell_completion *c,
+                                      int words_start, int words_end) {
+  char line[LINE_SIZE];
+  char const *argv[N_ARGS + 1];
+  int words_length = words_end - words_start;
+  memcpy(line, g_console.prompt + words_start, words_length);
+  line[words_length] = '\0';
+
+  int argc = rqshell_arg_split(line, words_length, argv, N_ARGS - 1);
+  if (argc <= 0 || argc >= N_ARGS) {
+    return;
+  }
+  struct rqshell_command const *command = rqshell_cmdtable_find(
+      &g_console.commands, argv[0], (int)strlen(argv[0]));
+  if (!command || !command->complete) {
+    return;
+  }
+
+  char word[LINE_SIZE];
+  memcpy(word, c->word, c->word_length);
+  word[c->word_length] = '\0';
+  argv[argc++] = word;
+  argv[argc] = NULL;
+  command->complete(c, argc, argv);
+}
+
+// Insert text at the cursor, if it fits in the prompt.
+static void rqshell_insert_text(char const *text, int length) {
+  char *insertion_point = g_console.prompt + g_console.cursor.byteoffset;
+  int rest_size = (int)strlen(insertion_point) + 1;
+  if (g_console.cursor.byteoffset + rest_size + length > LINE_SIZE) {
+    return;
+  }
+
+  memmove(insertion_point + length, insertion_point, rest_size);
+  memcpy(insertion_point, text, length);
+  rqshell_move_right(length);
+}
+
+// List the candidates in rows of at most COMPLETION_WIDTH characters.
+static void rqshell_list_completion(struct rqshell_completion const *c) {
+  char row[COMPLETION_WIDTH + 1];
+  int used = 0;
+  for (unsigned i = 0; i < c->shown_count; ++i) {
+    int length = (int)strlen(c->shown[i]);
+    if (used > 0 && used + 2 + length > COMPLETION_WIDTH) {
+      rqshell_printlnn(row, used);
+      used = 0;
+    }
+    if (used > 0) {
+      memcpy(row + used, "  ", 2);
+      used += 2;
+    }
+    int room = COMPLETION_WIDTH - used;
+    memcpy(row + used, c->shown[i], length < room ? length : room);
+    used += length < room ? length : room;
+  }
+  if (used > 0) {
+    rqshell_printlnn(row, used);
+  }
+  if (c->count > c->shown_count) {
+    rqshell_printlnf("... and %u more", c->count - c->shown_count);
+  }
+}
+
+// Tab completes the word before the cursor, see rqshell_register_completer.
+static inline void rqshell_handle_tab() {
+  if (!IsKeyPressed(KEY_TAB)) {
+    return;
+  }
+
+  char const *prompt = g_console.prompt;
+  int end = g_console.cursor.byteoffset;
+  int start = end;
+  while (start > 0 && !is_white_space(prompt[start - 1])) {
+    start--;
+  }
+  int first = 0;
+  while (first < start && is_white_space(prompt[first])) {
+    first++;
+  }
+  // the command after the time keyword is completed like the first word
+  if (first + 4 < start && is_white_space(prompt[first + 4]) &&
+      rqshell_is_time_keyword(prompt + first, 4)) {
+    first += 4;
+    while (first < start && is_white_space(prompt[first])) {
+      first++;
+    }
+  }
+
+  struct rqshell_completion *c = &g_console.completion;
+  c->word = prompt + start;
+  c->word_length = end - start;
+  c->common_length = 0;
+  c->count = 0;
+  c->shown_count = 0;
+  c->arena_used = 0;
+
+  if (first == start) {
+    rqshell_complete_command(c);
+  } else {
+    rqshell_complete_argument(c, first, start);
+  }
+  if (c->count == 0) {
+    return;
+  }
+
+  int added = c->common_length - c->word_length;
+  if (added > 0) {
+    rqshell_insert_text(c->common + c->word_length, added);
+  }
+  if (c->count == 1 && c->common[c->common_length - 1] != '/' &&
+      !is_white_space(g_console.prompt[g_console.cursor.byteoffset])) {
+    rqshell_insert_text(" ", 1);
+  } else if (c->count > 1 && added <= 0) {
+    rqshell_println(g_console.prompt);
+    rqshell_list_completion(c);
+  }
+}
+
+static inline void rqshell_handle_paste() {
+  if (!IsKeyDown(KEY_LEFT_CONTROL) || !IsKeyPressed(KEY_V)) {
+    return;
+  }
+
+  const char *clip = GetClipboardText();
+
+  if (!clip) {
+    return;
+  }
+
+  const char *line_end = strpbrk(clip, "\n");
+  const char *line_start = clip;
+  int line_size = 0;
+
+  while (line_end && line_start) {
+    line_size = (line_end - line_start) -
+                ((line_end - clip) >= 2 && line_end[-1] == '\r' ? 1 : 0);
 
     size_t max_length =
-        (size_t)fmin((float)(LINE_SIZE - g_console.cursor.byteoffset), (float)line_size);
+        (size_t)fmin((float)(LINE_SIZE - 1 - g_console.cursor.byteoffset), (float)line_size);
 
-    memcpy(g_console.text[0] + g_console.cursor.byteoffset, line_start,
+    memcpy(g_console.prompt + g_console.cursor.byteoffset, line_start,
            max_length);
-    g_console.text[0][max_length] = '\0';
-    rqshell_shift_up(g_console.text, N_LINES);
+    g_console.prompt[g_console.cursor.byteoffset + max_length] = '\0';
+    rqshell_push_text(g_console.prompt);
+    memset(g_console.prompt, '\0', LINE_SIZE);
     g_console.cursor.byteoffset = 0;
 
     line_start = line_end + 1;
@@ -503,93 +2067,442 @@ static inline void rqshell_handle_paste() {
 
   if (!line_end && line_start) {
     size_t max_length =
-        (size_t)fmin((float)(LINE_SIZE - g_console.cursor.byteoffset), (float)strlen(line_start));
-    memset(g_console.text[0], '\0', LINE_SIZE);
-    memcpy(g_console.text[0], line_start, max_length);
+        (size_t)fmin((float)(LINE_SIZE - 1 - g_console.cursor.byteoffset), (float)strlen(line_start));
+    memset(g_console.prompt, '\0', LINE_SIZE);
+    memcpy(g_console.prompt, line_start, max_length);
 
-    g_console.text[0][max_length] = '\0';
+    g_console.prompt[max_length] = '\0';
     g_console.cursor.byteoffset += max_length;
   }
 }
 
-void rqshell_update() {
+static void rqshell_update_frame() {
+  g_console.prof.frames[g_console.prof.next] = GetFrameTime() * 1000.f;
+  memset(&g_console.prof.cost[g_console.prof.next], 0,
+         sizeof(g_console.prof.cost[0]));
+  g_console.prof.next = (g_console.prof.next + 1) % PROF_FRAMES;
+  g_console.prof.updates++;
+
+  rqshell_flush_raylib_log();
+  rqshell_drain_posted();
+  rqshell_reap_jobs();
+
+  rqshell_step_task();
+
   rqshell_update_animation();
 
+  if (g_console.opening_animation.state != CONSOLE_CLOSED) {
+    rqshell_sample_watches();
+  }
+
   if (g_console.opening_animation.state != CONSOLE_OPENED) {
     return;
   }
 
-  rqshell_handle_history();
+  rqshell_handle_cancel();
+
+  if (g_console.find.active) {
+    rqshell_find_refresh();
+  }
+
+  if (!g_console.task.step && !rqshell_handle_search() &&
+      !rqshell_handle_find()) {
+    rqshell_handle_history();
 
-  rqshell_handle_cursor_move();
+    rqshell_handle_cursor_move();
 
-  rqshell_handle_enter();
+    rqshell_handle_enter();
 
-  rqshell_handle_backspace();
+    rqshell_handle_backspace();
 
-  rqshell_handle_paste();
+    rqshell_handle_paste();
 
-  int c = GetCharPressed();
-  if (c != 0) {
-    rqshell_put_char(&g_console, c);
+    rqshell_handle_tab();
+
+    int c = GetCharPressed();
+    if (c == '/' && g_console.prompt[0] == '\0') {
+      rqshell_find_start();
+    } else if (c != 0) {
+      rqshell_put_char(&g_console, c);
+    }
   }
 
   rqshell_handle_cursor();
 
-  g_console.view_port.offset.y =
+  float offset =
       Clamp((g_console.view_port.offset.y +
              ((float)GetMouseWheelMove() * g_console.font_size)),
-            0.f, N_LINES * (g_console.font_size + 2.f));
+            0.f, rqshell_row_count() * (g_console.font_size + 2.f));
+  if (offset != g_console.view_port.offset.y) {
+    g_console.view_port.offset.y = offset;
+    g_console.cache.dirty = true;
+  }
 }
 
-void rqshell_render() {
+// Find the scrollback lines [first, last) that intersect a pane of the given
+// height. Line i is drawn i + 2 line heights above the bottom of the pane,
+// plus the pinned rows, and the view port offset moves everything down.
+static inline void rqshell_visible_lines(float height, unsigned *first,
+                                         unsigned *last) {
+  float line_height = g_console.font_size + 2.f;
+  float offset = g_console.view_port.offset.y;
+  unsigned line_count = rqshell_row_count();
+
+  float pinned = (float)rqshell_pinned_rows();
+  float top = floorf(offset / line_height) - 1.f - pinned;
+  float bottom = ceilf((height + offset) / line_height) - 1.f - pinned;
+
+  *first = top > 0.f ? (unsigned)top : 0;
+  *last = bottom > 0.f ? (unsigned)bottom : 0;
+  if (*last > line_count) {
+    *last = line_count;
+  }
+  if (*first > *last) {
+    *first = *last;
+  }
+}
+
+// Make sure the cache target matches the fully opened console size.
+static inline void rqshell_reload_cache() {
+  int width = GetScreenWidth();
+  int height = (int)ceilf(GetScreenHeight() / 3.f);
+
+  if (g_console.cache.target.id != 0 &&
+      g_console.cache.target.texture.width == width &&
+      g_console.cache.target.texture.height == height) {
+    return;
+  }
+
+  if (g_console.cache.target.id != 0) {
+    UnloadRenderTexture(g_console.cache.target);
+  }
+  g_console.cache.target = LoadRenderTexture(width, height);
+  g_console.window.width = (float)width;
+  g_console.cache.dirty = true;
+}
+
+// Redraw the scrollback into the cache target, anchored to its bottom edge so
+// the opening animation only changes how much of it is shown.
+static inline void rqshell_redraw_cache() {
+  float height = (float)g_console.cache.target.texture.height;
+
+  BeginTextureMode(g_console.cache.target);
+  ClearBackground(BLANK);
+  BeginMode2D(g_console.view_port);
+
+  unsigned first, last;
+  rqshell_visible_lines(height, &first, &last);
+  for (unsigned i = first; i < last; ++i) {
+    char const *line = rqshell_row_text(i);
+    if (line[0] == '\0') {
+      continue;
+    }
+
+    float hn = height - ((g_console.font_size + 2.f) *
+                         (i + 2 + rqshell_pinned_rows()));
+
+    if (g_console.find.active && g_console.find.length > 0) {
+      rqshell_highlight_hits(line, i, hn);
+    }
+
+    rqshell_count_draw(line);
+    DrawTextEx(g_console.font, line, (Vector2){.x = 0, .y = hn},
+               g_console.font_size, 1.2f, g_console.font_color);
+  }
+
+  EndMode2D();
+  EndTextureMode();
+
+  g_console.cache.dirty = false;
+}
+
+void rqshell_prof_show_graph(bool show) { g_console.prof.graph = show; }
+
+bool rqshell_prof_graph_shown(void) { return g_console.prof.graph; }
+
+// Draw the latest frame times as bars in the top right of the pane, scaled
+// so two 60 fps frames fill the height, with a line at one 60 fps frame.
+static void rqshell_draw_prof_graph() {
+  float const full_ms = 2.f * 1000.f / 60.f;
+  float height = 3.f * (g_console.font_size + 2.f);
+  float x = g_console.window.x + g_console.window.width - PROF_FRAMES - 8.f;
+  float bottom = g_console.window.y + 8.f + height;
+
+  Color color = g_console.font_color;
+  color.a = 40;
+  rqshell_count_draw(NULL);
+  DrawRectangleRec((Rectangle){.x = x,
+                               .y = bottom - height,
+                               .width = PROF_FRAMES,
+                               .height = height},
+                   color);
+
+  color.a = 200;
+  float worst = 0.f;
+  for (unsigned i = 0; i < PROF_FRAMES; ++i) {
+    float ms = g_console.prof.frames[(g_console.prof.next + i) % PROF_FRAMES];
+    worst = fmaxf(worst, ms);
+    float bar = Clamp(ms / full_ms, 0.f, 1.f) * height;
+    rqshell_count_draw(NULL);
+    DrawLineV((Vector2){.x = x + i + 0.5f, .y = bottom},
+              (Vector2){.x = x + i + 0.5f, .y = bottom - bar}, color);
+  }
+  rqshell_count_draw(NULL);
+  DrawLineV((Vector2){.x = x, .y = bottom - height / 2.f},
+            (Vector2){.x = x + PROF_FRAMES, .y = bottom - height / 2.f},
+            g_console.font_color);
+
+  char label[64];
+  unsigned newest = (g_console.prof.next + PROF_FRAMES - 1) % PROF_FRAMES;
+  snprintf(label, sizeof(label), "frame %.1f ms, worst %.1f ms",
+           g_console.prof.frames[newest], worst);
+  rqshell_count_draw(label);
+  DrawTextEx(g_console.font, label,
+             (Vector2){.x = x, .y = bottom + 2.f}, g_console.font_size, 1.2f,
+             g_console.font_color);
+}
+
+static void rqshell_render_frame() {
+  if (g_console.opening_animation.state == CONSOLE_CLOSED) {
+    return;
+  }
+
+  rqshell_reload_cache();
+  // whatever makes the scrollback stale, like a new font or screen size,
+  // makes the pinned lines stale too
+  if (g_console.watch.dirty || g_console.cache.dirty) {
+    rqshell_redraw_watches();
+  }
+  if (g_console.cache.dirty) {
+    rqshell_redraw_cache();
+  }
+
+  rqshell_count_draw(NULL);
   DrawRectangleRec(g_console.window, g_console.background_color);
+
+  // render textures are stored upside down, hence the negative height
+  rqshell_count_draw(NULL);
+  DrawTextureRec(g_console.cache.target.texture,
+                 (Rectangle){.x = 0,
+                             .y = 0,
+                             .width = g_console.window.width,
+                             .height = -g_console.window.height},
+                 (Vector2){.x = g_console.window.x, .y = g_console.window.y},
+                 WHITE);
+
   BeginScissorMode((int)g_console.window.x, (int)g_console.window.y,
                    (int)g_console.window.width, (int)g_console.window.height);
+
+  if (g_console.watch.count > 0) {
+    float watch_height = (float)g_console.watch.target.texture.height;
+    rqshell_count_draw(NULL);
+    DrawTextureRec(
+        g_console.watch.target.texture,
+        (Rectangle){.x = 0,
+                    .y = 0,
+                    .width = (float)g_console.watch.target.texture.width,
+                    .height = -watch_height},
+        (Vector2){.x = g_console.window.x,
+                  .y = g_console.window.y + g_console.window.height -
+                       (g_console.font_size + 2.f) - watch_height},
+        WHITE);
+  }
+
+  if (g_console.prof.graph) {
+    rqshell_draw_prof_graph();
+  }
+
   BeginMode2D(g_console.view_port);
 
   float prompt_height = (g_console.window.y + g_console.window.height) -
                         (g_console.font_size + 2.f);
+  rqshell_count_draw(g_console.show_buffer);
   DrawTextEx(g_console.font, g_console.show_buffer,
              (Vector2){.x = 0, .y = prompt_height}, g_console.font_size, 1.2f,
              g_console.font_color);
 
-  for (int i = 1; i < N_LINES; ++i) {
-    float hn = (g_console.window.y + g_console.window.height) -
-               ((g_console.font_size + 2.f) * (i + 1));
-
-    DrawTextEx(g_console.font, g_console.text[i], (Vector2){.x = 0, .y = hn},
-               g_console.font_size, 1.2f, g_console.font_color);
-  }
   EndMode2D();
   EndScissorMode();
 }
 
+// The console's own cost is measured around the update and render steps.
+// Command handlers are left out of the update time, cmdstats shows them.
+
+void rqshell_update() {
+  unsigned long long start = rqshell_now_ns();
+  g_console.prof.handler_ns = 0;
+  g_console.prof.updating = true;
+  rqshell_update_frame();
+  g_console.prof.updating = false;
+  unsigned long long ns = rqshell_now_ns() - start;
+  ns = ns > g_console.prof.handler_ns ? ns - g_console.prof.handler_ns : 0;
+  g_console.prof.cost[rqshell_frame_slot()].update_ms = ns / 1e6f;
+}
+
+void rqshell_render() {
+  unsigned long long start = rqshell_now_ns();
+  rqshell_render_frame();
+  g_console.prof.cost[rqshell_frame_slot()].render_ms +=
+      (rqshell_now_ns() - start) / 1e6f;
+}
+
+static int rqshell_compare_ms(void const *a, void const *b) {
+  float x = *(float const *)a, y = *(float const *)b;
+  return (x > y) - (x < y);
+}
+
+// Average, 99th percentile and worst of n frame times, sorting them.
+static void rqshell_frame_stats(float *ms, unsigned n, double *avg,
+                                double *p99, double *max) {
+  *avg = *p99 = *max = 0.0;
+  if (n == 0) {
+    return;
+  }
+  qsort(ms, n, sizeof(*ms), rqshell_compare_ms);
+  double sum = 0.0;
+  for (unsigned i = 0; i < n; ++i) {
+    sum += ms[i];
+  }
+  *avg = sum / n;
+  *p99 = ms[(n * 99 + 99) / 100 - 1]; // nearest rank, as the prof command
+  *max = ms[n - 1];
+}
+
+static size_t rqshell_texture_bytes(RenderTexture2D const *target) {
+  // a color attachment of four bytes a pixel, and a depth buffer as big
+  return target->id == 0
+             ? 0
+             : 2 * 4 * (size_t)target->texture.width * target->texture.height;
+}
+
+void rqshell_get_self_stats(struct rqshell_self_stats *stats) {
+  *stats = (struct rqshell_self_stats){0};
+
+  // a frame still being updated, as when a command asks, is left out
+  unsigned skip = g_console.prof.updating ? 1 : 0;
+  unsigned long long done = g_console.prof.updates;
+  done = done > skip ? done - skip : 0;
+  unsigned n = done < PROF_FRAMES - skip ? (unsigned)done : PROF_FRAMES - skip;
+  stats->frames = n;
+
+  float update[PROF_FRAMES], render[PROF_FRAMES];
+  for (unsigned i = 0; i < n; ++i) {
+    // newest first
+    unsigned slot =
+        (rqshell_frame_slot() + PROF_FRAMES - skip - i) % PROF_FRAMES;
+    update[i] = g_console.prof.cost[slot].update_ms;
+    render[i] = g_console.prof.cost[slot].render_ms;
+    if (i == 0) {
+      stats->draws = g_console.prof.cost[slot].draws;
+      stats->glyphs = g_console.prof.cost[slot].glyphs;
+    }
+    if (g_console.prof.cost[slot].draws > stats->draws_max) {
+      stats->draws_max = g_console.prof.cost[slot].draws;
+    }
+    if (g_console.prof.cost[slot].glyphs > stats->glyphs_max) {
+      stats->glyphs_max = g_console.prof.cost[slot].glyphs;
+    }
+  }
+  rqshell_frame_stats(update, n, &stats->update_avg_ms, &stats->update_p99_ms,
+                      &stats->update_max_ms);
+  rqshell_frame_stats(render, n, &stats->render_avg_ms, &stats->render_p99_ms,
+                      &stats->render_max_ms);
+
+  stats->scrollback_bytes = rqshell_lines_footprint(&g_console.text);
+  stats->scrollback_lines = rqshell_lines_count(&g_console.text);
+  stats->history_bytes =
+      rqshell_history_footprint(&g_console.history.entries);
+  stats->history_mapped_bytes = g_console.history.entries.map_size;
+  stats->command_bytes = rqshell_cmdtable_footprint(&g_console.commands) +
+                         rqshell_trie_footprint(&g_console.names);
+  stats->commands = g_console.commands.used;
+  stats->other_bytes =
+      rqshell_cvars_footprint(&g_console.cvars) +
+      g_console.search.state.cap * sizeof(*g_console.search.state.candidates) +
+      g_console.find.cap * sizeof(*g_console.find.hits) +
+      rqshell_prof_footprint();
+  stats->static_bytes = sizeof(g_console);
+  stats->texture_bytes = rqshell_texture_bytes(&g_console.cache.target) +
+                         rqshell_texture_bytes(&g_console.watch.target);
+}
+
 void rqshell_set_active_key(int key) { g_console.activation_key = key; }
 
 void rqshell_set_font(Font f, float size) {
   g_console.font = f;
   g_console.font_size = size;
+  g_console.cache.dirty = true;
 }
 
 bool rqshell_is_active() {
   return g_console.opening_animation.state == CONSOLE_OPENED;
 }
 
-void rqshell_set_background_color(Color c) { g_console.background_color = c; }
+void rqshell_set_background_color(Color c) {
+  g_console.background_color = c;
+  g_console.cache.dirty = true;
+}
 
 Color rqshell_get_background_color() { return g_console.background_color; }
 
-void rqshell_set_font_size(float font_size) { g_console.font_size = font_size; }
+void rqshell_set_font_size(float font_size) {
+  g_console.font_size = font_size;
+  g_console.cache.dirty = true;
+}
 
-void rqshell_set_font_color(Color c) { g_console.font_color = c; }
+void rqshell_set_font_color(Color c) {
+  g_console.font_color = c;
+  g_console.cache.dirty = true;
+}
 
 Color rqshell_get_font_color() { return g_console.font_color; }
 
-void rqshell_clear() {
-  for (int i = 0; i < N_LINES; ++i) {
-    g_console.text[i][0] = '\0';
+void rqshell_set_scrollback_limit(size_t bytes) {
+  rqshell_lines_set_limit(&g_console.text, bytes);
+}
+
+void rqshell_set_history_limit(size_t bytes) {
+  rqshell_history_set_limit(&g_console.history.entries, bytes);
+}
+
+bool rqshell_set_history_file(char const *path) {
+  g_console.history.index = 0;
+  return rqshell_history_open(&g_console.history.entries, path);
+}
+
+void rqshell_close() {
+  rqshell_cancel_task();
+  rqshell_workers_stop(&g_console.workers);
+  rqshell_reap_jobs();
+
+  rqshell_lines_free(&g_console.text);
+  rqshell_history_free(&g_console.history.entries);
+  rqshell_trigram_search_free(&g_console.search.state);
+  g_console.search.active = false;
+  free(g_console.find.hits);
+  g_console.find.hits = NULL;
+  g_console.find.count = g_console.find.cap = 0;
+  g_console.find.active = false;
+  rqshell_cmdtable_free(&g_console.commands);
+  rqshell_trie_free(&g_console.names);
+  rqshell_cvars_free(&g_console.cvars);
+
+  if (g_console.cache.target.id != 0) {
+    UnloadRenderTexture(g_console.cache.target);
+    g_console.cache.target = (RenderTexture2D){0};
   }
+  if (g_console.watch.target.id != 0) {
+    UnloadRenderTexture(g_console.watch.target);
+    g_console.watch.target = (RenderTexture2D){0};
+  }
+  g_console.watch.count = 0;
+}
+
+void rqshell_clear() {
+  rqshell_lines_clear(&g_console.text);
+  g_console.prompt[0] = '\0';
+  g_console.cache.dirty = true;
+  g_console.repeat.count = 0;
   g_console.cursor.byteoffset = 0;
   g_console.cursor.direction = CURSOR_NO_MOVE;
 }
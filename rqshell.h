@@ -3,6 +3,7 @@
 #define _HEADER_FILE_rqshell_20230115155057_
 
 #include "raylib.h"
+#include <stddef.h>
 
 /*
  * The consoles one-time initialization routine.
@@ -11,6 +12,12 @@
  */
 void rqshell_init();
 
+/*
+ * Release the memory held by the console.
+ * Call once when the console is no longer used.
+ */
+void rqshell_close();
+
 /*
  * Update step of the console.
  * Must be called in your application's update step.
@@ -25,9 +32,19 @@ void rqshell_render();
 
 /*
  * Write a line to the console.
+ * A line that repeats the newest line is not added again, instead a repeat
+ * count like " (x3)" is shown after the newest line.
+ * Must only be called from the thread running the update step,
+ * use rqshell_post from other threads.
  */
 void rqshell_println(char const *text);
 
+/*
+ * Same as rqshell_println, but the text is given with an explicit length and
+ * does not need to be null terminated.
+ */
+void rqshell_printlnn(char const *text, int len);
+
 /*
  * Write a formatted line to the console.
  * Wraps around C standard library printf functionality, so
@@ -35,18 +52,472 @@ void rqshell_println(char const *text);
  */
 void rqshell_printlnf(char const *format, ...);
 
+/*
+ * Write a formatted line to the console, but only format it once the line is
+ * read, for example when it scrolls into view. Only the format pointer and the
+ * argument values are stored, which makes this cheap for hot code paths.
+ *
+ * The format string must stay valid for as long as the line is in the
+ * console, which holds for string literals. Strings passed for %s are copied.
+ * Formats using wide characters or %n are formatted right away instead.
+ */
+void rqshell_printlnf_deferred(char const *format, ...);
+
+/*
+ * Token bucket state for rate limited printing.
+ * Zero initialize it, one per call site.
+ */
+struct rqshell_rate_limit {
+  double tokens;
+  double last; // time of the last check, in raylib GetTime seconds
+  unsigned dropped; // number of times printing was refused
+};
+
+/*
+ * Take a token from the bucket, which refills at per_second tokens per second
+ * and holds at most burst tokens.
+ *
+ * Returns true iff a token was available and the message may be printed.
+ */
+bool rqshell_rate_limit_allow(struct rqshell_rate_limit *limit,
+                              float per_second, float burst);
+
+/*
+ * Print a formatted line at most per_second times per second on average,
+ * allowing bursts of up to burst lines. The limit is kept per call site,
+ * and dropped lines are never formatted.
+ */
+#define RQSHELL_PRINTLNF_LIMITED(per_second, burst, ...)                       \
+  do {                                                                         \
+    static struct rqshell_rate_limit rqshell_limit_;                           \
+    if (rqshell_rate_limit_allow(&rqshell_limit_, (per_second), (burst))) {    \
+      rqshell_printlnf(__VA_ARGS__);                                           \
+    }                                                                          \
+  } while (0)
+
+/*
+ * What to do when lines are posted faster than the console takes them.
+ * Either way the newest lines are dropped and counted.
+ */
+enum rqshell_overflow {
+  RQSHELL_OVERFLOW_DROP, // drop silently
+  RQSHELL_OVERFLOW_COUNT, // also write how many were dropped to the console
+};
+
+/*
+ * Write a line to the console from any thread.
+ * The line is queued without blocking and shows up in the console at the next
+ * update step. May be called after rqshell_init.
+ *
+ * Returns false if the queue was full and the line was dropped.
+ */
+bool rqshell_post(char const *text);
+
+/*
+ * Write a formatted line to the console from any thread.
+ * Same as rqshell_post, with the format rules of rqshell_printlnf.
+ *
+ * Returns false if the queue was full and the line was dropped.
+ */
+bool rqshell_postf(char const *format, ...);
+
+/*
+ * Set what happens when posted lines overflow the queue.
+ *
+ * The default policy is RQSHELL_OVERFLOW_COUNT.
+ */
+void rqshell_set_overflow_policy(enum rqshell_overflow policy);
+
+/*
+ * Get the total number of posted lines dropped because the queue was full.
+ */
+size_t rqshell_get_dropped_count();
+
+/*
+ * Route raylib's trace log into the console, or back to raylib's default
+ * output when enable is false. Log lines are tagged with their level and
+ * added to the console in one batch per update step.
+ *
+ * raylib must only log from the thread running the update step
+ * while capturing is enabled.
+ */
+void rqshell_capture_raylib_log(bool enable);
+
+/*
+ * Set the least important raylib log level shown in the console,
+ * using raylib's TraceLogLevel values.
+ * raylib's own SetTraceLogLevel filter is applied first.
+ *
+ * The default level is LOG_INFO.
+ */
+void rqshell_set_log_level(int log_level);
+
 /*
  * Clears the console text pane of text.
  */
 void rqshell_clear();
 
+/*
+ * Set how many bytes of text the scrollback may hold.
+ * The oldest lines are dropped when the limit is exceeded.
+ *
+ * The default limit is SCROLLBACK_LIMIT from rqshell_config.h.
+ */
+void rqshell_set_scrollback_limit(size_t bytes);
+
+/*
+ * Set how many bytes of entered commands the history may hold.
+ * The oldest commands are dropped when the limit is exceeded.
+ *
+ * The default limit is HISTORY_LIMIT from rqshell_config.h.
+ */
+void rqshell_set_history_limit(size_t bytes);
+
+/*
+ * Keep the history in the file at path, so it carries over between runs.
+ * Entered commands are appended to the file, and the file is memory mapped
+ * so the commands of earlier runs are read from it only when they are shown.
+ * Once the file holds twice the history limit, it is compacted down to the
+ * newest unique commands that fit the limit.
+ * Call after rqshell_init.
+ *
+ * Returns false if the file could not be opened.
+ */
+bool rqshell_set_history_file(char const *path);
+
 /*
  * Register an function handler that gets called when
  * the given prefix is observed from the user input.
+ * The prefix is not copied, so it must stay valid while the console is used.
  *
  * This is how extend the functionality of the console.
+ *
+ * Returns false if a command with the same prefix is already registered.
+ */
+bool rqshell_register(const char *prefix, void (*handler)(int, char const *));
+
+/*
+ * Register an function handler like rqshell_register, but the handler is
+ * given the already tokenized command line, like the arguments of main.
+ * argv[0] is the command name, and argv[argc] is a null pointer.
+ *
+ * Returns false if a command with the same prefix is already registered.
+ */
+bool rqshell_register_argv(const char *prefix,
+                           void (*handler)(int argc, char const **argv));
+
+/*
+ * A resumable command in progress, see rqshell_register_task.
+ */
+struct rqshell_task {
+  void *state; // owned by the task, a null pointer on the first step
+  float progress; // set by the task, from 0 to 1, or negative when unknown
+  bool cancelled; // true on the final step when the user cancelled the task
+  double deadline; // GetTime value at which the current step should return
+};
+
+/*
+ * What a task step reports back to the console.
+ */
+enum rqshell_task_status {
+  RQSHELL_TASK_RUNNING, // call the step again next update
+  RQSHELL_TASK_DONE, // the task is finished
+};
+
+/*
+ * Register a command that runs over several frames.
+ * The step function is called once when the command is entered, and then
+ * once per update step until it returns RQSHELL_TASK_DONE. Each step should
+ * do a slice of work and return once rqshell_task_should_yield says so.
+ * The arguments are given like rqshell_register_argv and stay valid until
+ * the task is done.
+ *
+ * Only one task runs at a time, and the prompt shows its progress while it
+ * runs. Ctrl+C cancels the task: the step is then called a last time with
+ * cancelled set, so it can release its state.
+ *
+ * Returns false if a command with the same prefix is already registered.
+ */
+bool rqshell_register_task(const char *prefix,
+                           enum rqshell_task_status (*step)(
+                               struct rqshell_task *task, int argc,
+                               char const **argv));
+
+/*
+ * Query whether the current task step has used up its time budget.
+ *
+ * Returns true iff the step should return now.
+ */
+bool rqshell_task_should_yield(struct rqshell_task const *task);
+
+/*
+ * Set how many milliseconds a task may run per update step.
+ *
+ * The default budget is TASK_BUDGET_MS from rqshell_config.h.
+ */
+void rqshell_set_task_budget(float milliseconds);
+
+/*
+ * A command running on a worker thread, see rqshell_register_async.
+ */
+struct rqshell_job;
+
+/*
+ * Register an function handler like rqshell_register_argv, but the handler
+ * runs on a worker thread, so blocking work does not stall the frame.
+ * The handler gets its own copy of the arguments.
+ *
+ * rqshell_println and rqshell_printlnf may be called from the handler, the
+ * lines show up at a later update step. When the console falls behind, the
+ * handler waits for room instead of losing lines.
+ * Ctrl+c cancels the running commands, so handlers should check
+ * rqshell_job_cancelled regularly and return early once it is true.
+ *
+ * Returns false if a command with the same prefix is already registered.
+ */
+bool rqshell_register_async(const char *prefix,
+                            void (*handler)(struct rqshell_job *job, int argc,
+                                            char const **argv));
+
+/*
+ * Check if the user cancelled the command running the job.
+ * Safe to call from the job's worker thread.
+ */
+bool rqshell_job_cancelled(struct rqshell_job const *job);
+
+/*
+ * Let the calling thread print for the job like the job's own worker thread,
+ * for handlers that spread their work over threads of their own.
+ * Pass a null pointer to stop.
+ */
+void rqshell_job_attach(struct rqshell_job *job);
+
+/*
+ * Call f with the name of every command queued or running on a worker thread.
+ */
+void rqshell_foreach_job(void (*f)(char const *name, bool running, void *user),
+                         void *user);
+
+/*
+ * Call a function for every registered command, in sorted name order.
+ * The user pointer is passed along to each call.
+ */
+void rqshell_foreach_command(void (*f)(char const *name, void *user),
+                             void *user);
+
+/*
+ * Latency of a registered command, see rqshell_foreach_command_stats.
+ */
+struct rqshell_command_stats {
+  unsigned long long calls;
+  double total_ms;
+  double max_ms;
+};
+
+/*
+ * Call f with the latency of every command that ran since the last reset,
+ * ordered by name. Every handler call is timed: a task counts the time of
+ * all its steps, and an async command the time it ran on its worker.
+ *
+ * A command line starting with the time keyword, like "time ls", also
+ * prints how long the command took and what its output cost. A command
+ * registered under the name time replaces the keyword.
+ */
+void rqshell_foreach_command_stats(
+    void (*f)(char const *name, struct rqshell_command_stats const *stats,
+              void *user),
+    void *user);
+
+/*
+ * Forget the latency of all commands.
+ */
+void rqshell_reset_command_stats(void);
+
+/*
+ * The candidates gathered while completing a word, see
+ * rqshell_register_completer.
+ */
+struct rqshell_completion;
+
+/*
+ * Offer a candidate for the word being completed.
+ * Candidates that do not start with the word are ignored.
+ */
+void rqshell_completion_add(struct rqshell_completion *, char const *candidate);
+
+/*
+ * Register a function that completes the arguments of a registered command.
+ *
+ * Pressing tab completes the word before the cursor. The first word is
+ * completed from the registered command names. For later words the
+ * completer of the command is called with the words before the cursor,
+ * argv[0] being the command name and argv[argc - 1] the word being completed,
+ * which may be empty. It offers whole words with rqshell_completion_add.
+ *
+ * A single candidate replaces the word and is followed by a space, unless it
+ * ends in '/' so a path can be completed further. Several candidates extend
+ * the word as far as they agree, and are listed when they do not extend it.
+ *
+ * Returns false if no command with that prefix is registered.
+ */
+bool rqshell_register_completer(const char *prefix,
+                                void (*completer)(struct rqshell_completion *c,
+                                                  int argc, char const **argv));
+
+/*
+ * Bind a console variable to a value in game memory, so the set, get, toggle
+ * and list commands can read and change it while the game runs.
+ * The game keeps using the value directly, so a bound variable costs nothing
+ * per frame, and text is only parsed when the variable is set.
+ * The name is not copied, so it must stay valid while the console is used.
+ * A string variable holds at most size - 1 characters.
+ *
+ * Returns false if a variable with the same name is already bound.
+ */
+bool rqshell_cvar_bind_float(char const *name, float *value);
+
+bool rqshell_cvar_bind_int(char const *name, int *value);
+
+bool rqshell_cvar_bind_bool(char const *name, bool *value);
+
+bool rqshell_cvar_bind_string(char const *name, char *value, size_t size);
+
+/*
+ * Set a variable from text, parsed according to the type it was bound with.
+ *
+ * Returns false, printing why, if no such variable is bound or the text is
+ * not a valid value.
+ */
+bool rqshell_cvar_set(char const *name, char const *text);
+
+/*
+ * Flip a variable bound with rqshell_cvar_bind_bool.
+ *
+ * Returns false, printing why, if no such bool variable is bound.
+ */
+bool rqshell_cvar_toggle(char const *name);
+
+/*
+ * Get the value of a variable as text.
+ * The returned string is valid until the variable is read again.
+ *
+ * Returns a null pointer if no such variable is bound.
+ */
+char const *rqshell_cvar_get(char const *name);
+
+/*
+ * Call f with the name, type and value of every variable, ordered by name.
+ */
+void rqshell_foreach_cvar(void (*f)(char const *name, char const *type,
+                                    char const *value, void *user),
+                          void *user);
+
+/*
+ * Pin a bound variable above the prompt while the console is open.
+ * The value is sampled every interval frames, and the pinned lines are only
+ * drawn again when a sampled value changed. Watching a variable again
+ * changes its interval.
+ *
+ * Returns false, printing why, if no such variable is bound or WATCH_LIMIT
+ * variables are already watched.
+ */
+bool rqshell_watch(char const *name, unsigned interval);
+
+/*
+ * Stop watching a variable, or every variable when name is a null pointer.
+ *
+ * Returns false if the variable was not watched.
+ */
+bool rqshell_unwatch(char const *name);
+
+/*
+ * Call f with the name, interval and last sampled value of every watched
+ * variable.
+ */
+void rqshell_foreach_watch(void (*f)(char const *name, unsigned interval,
+                                     char const *value, void *user),
+                           void *user);
+
+/*
+ * Time a scope of code, from rqshell_prof_begin to the matching
+ * rqshell_prof_end on the same thread. Scopes nest, and may be timed from any
+ * thread. The name is not copied, so pass a string literal.
+ *
+ * Each thread records into rings of its own, without locks, keeping the
+ * newest PROF_SAMPLES durations of each scope. The prof command shows the
+ * rolling statistics of every scope.
+ */
+void rqshell_prof_begin(char const *name);
+
+void rqshell_prof_end(void);
+
+/*
+ * Rolling statistics of a profiled scope, over the durations kept.
+ */
+struct rqshell_prof_stats {
+  unsigned long long calls; // scopes ended since the last reset
+  unsigned samples; // durations the statistics are taken over
+  double min_us;
+  double avg_us;
+  double p99_us;
+  double max_us;
+};
+
+/*
+ * Call f with the statistics of every scope that has durations, in the order
+ * the scopes were first timed.
+ */
+void rqshell_prof_foreach(void (*f)(char const *name,
+                                    struct rqshell_prof_stats const *stats,
+                                    void *user),
+                          void *user);
+
+/*
+ * Forget the durations recorded so far.
+ */
+void rqshell_prof_reset(void);
+
+/*
+ * Show or hide the frame time graph drawn inside the console pane.
+ */
+void rqshell_prof_show_graph(bool show);
+
+bool rqshell_prof_graph_shown(void);
+
+/*
+ * What the console itself costs, see rqshell_get_self_stats.
+ */
+struct rqshell_self_stats {
+  unsigned frames; // frames the times and counts are taken over
+  double update_avg_ms; // rqshell_update, not counting command handlers
+  double update_p99_ms;
+  double update_max_ms;
+  double render_avg_ms; // rqshell_render
+  double render_p99_ms;
+  double render_max_ms;
+  unsigned draws; // raylib draw calls of the last frame, before batching
+  unsigned draws_max;
+  unsigned glyphs; // glyphs drawn in the last frame
+  unsigned glyphs_max;
+
+  // heap bytes held, including capacity not in use yet
+  size_t scrollback_bytes;
+  unsigned scrollback_lines;
+  size_t history_bytes; // commands of this run and the history search index
+  size_t history_mapped_bytes; // the history file, mapped and not on the heap
+  size_t command_bytes; // command table and the names for completion
+  unsigned commands;
+  size_t other_bytes; // variables, search state and profiler rings
+  size_t static_bytes; // the console state allocated up front
+  size_t texture_bytes; // render targets, in video memory
+};
+
+/*
+ * Get the time rqshell_update and rqshell_render took over the latest
+ * PROF_FRAMES frames, what they drew, and the memory the console holds.
+ * The shellstats command prints the same numbers.
  */
-void rqshell_register(const char *prefix, void (*handler)(int, char const *));
+void rqshell_get_self_stats(struct rqshell_self_stats *stats);
 
 /*
  * Set the console's activation key.
@@ -33,7 +33,6 @@ static inline int parse_fields(struct rqshell_arg_iter *iter, char **output, int
     iter->next++;
   }
 
-  int istart = iter->next;
   char const *start = iter->chrs + iter->next;
   int size = 0;
 
@@ -80,22 +79,7 @@ static inline int parse_fields(struct rqshell_arg_iter *iter, char **output, int
 }
 
 int rqshell_arg_iter_count_args(struct rqshell_arg_iter const *it) {
-  int arg_count = 0;
-
-  for (int i = 0, quote_level = 0; i < it->chr_count; ++i) {
-    int c = it->chrs[i];
-    if (is_white_space(c) && quote_level == 0) {
-      arg_count++;
-    } else if (is_quote(c)) {
-      quote_level = (quote_level > 0) ? (quote_level - 1) : (quote_level + 1);
-    }
-
-    if (i == (it->chr_count - 1) && quote_level == 0) {
-      arg_count++;
-    }
-  }
-
-  return arg_count;
+  return rqshell_arg_tokenize(it->chrs + it->next, it->chr_count - it->next, NULL, 0);
 }
 
 struct rqshell_arg_iter rqshell_arg_iter_init(char const *chs, int count) {
@@ -115,3 +99,57 @@ const char *rqshell_arg_iter_next(struct rqshell_arg_iter *iter) {
   buffer[size] = '\0';
   return buffer;
 }
+
+bool rqshell_arg_iter_next_view(struct rqshell_arg_iter *iter, struct rqshell_arg_view *view) {
+  char *start = NULL;
+  int size = parse_fields(iter, &start, LINE_SIZE);
+  if (size < 0) {
+    return false;
+  }
+  *view = (struct rqshell_arg_view){.chrs = start, .len = size};
+  return true;
+}
+
+int rqshell_arg_tokenize(char const *chs, int count, struct rqshell_arg_view *views,
+                         int max_views) {
+  struct rqshell_arg_iter iter = rqshell_arg_iter_init(chs, count);
+  int n = 0;
+
+  for (;;) {
+    for (; iter.next < iter.chr_count && is_white_space(iter.chrs[iter.next]); ++iter.next)
+      ;
+    if (iter.next >= iter.chr_count) {
+      return n;
+    }
+
+    char *start = NULL;
+    int size = parse_fields(&iter, &start, LINE_SIZE);
+    if (size < 0) {
+      return -1;
+    }
+    if (n < max_views) {
+      views[n] = (struct rqshell_arg_view){.chrs = start, .len = size};
+    }
+    n++;
+  }
+}
+
+bool rqshell_arg_view_equals(struct rqshell_arg_view view, char const *str) {
+  return strncmp(view.chrs, str, view.len) == 0 && str[view.len] == '\0';
+}
+
+int rqshell_arg_split(char *chs, int count, char const **argv, int max_args) {
+  struct rqshell_arg_view views[N_ARGS];
+  int n = rqshell_arg_tokenize(chs, count, views, N_ARGS);
+  if (n < 0) {
+    return -1;
+  }
+
+  for (int i = 0; i < n && i < N_ARGS && i < max_args; ++i) {
+    // the character after a field is whitespace, a closing quote or the end
+    char *field = chs + (views[i].chrs - chs);
+    field[views[i].len] = '\0';
+    argv[i] = field;
+  }
+  return n;
+}
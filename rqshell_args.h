@@ -2,6 +2,8 @@
 #ifndef _HEADER_FILE_rqshell_args_20230226003325_
 #define _HEADER_FILE_rqshell_args_20230226003325_
 
+#include <stdbool.h>
+
 /*
  * Console argument iterator.
  * An iterator that can parse a raw argument line into sub strings called fields.
@@ -14,6 +16,15 @@ struct rqshell_arg_iter {
   int next; // current place in the buffer
 };
 
+/*
+ * A field as a view into the original argument line.
+ * The characters are not null terminated.
+ */
+struct rqshell_arg_view {
+  char const *chrs; // first character of the field
+  int len; // character count of the field
+};
+
 /*
  * Create an iterator from command raw characters.
  */
@@ -26,7 +37,42 @@ struct rqshell_arg_iter rqshell_arg_iter_init(char const *chs, int count);
 const char *rqshell_arg_iter_next(struct rqshell_arg_iter *);
 
 /*
- * Count the number of arguments that can be extracted from the iterator.
+ * Get a view of the next argument without copying it.
+ *
+ * Returns false when there are no more arguments or the next field is malformed.
+ */
+bool rqshell_arg_iter_next_view(struct rqshell_arg_iter *, struct rqshell_arg_view *);
+
+/*
+ * Split a raw argument line into views in one pass.
+ * At most max_views views are written.
+ *
+ * Returns the number of arguments found, or -1 if a field is malformed.
+ */
+int rqshell_arg_tokenize(char const *chs, int count, struct rqshell_arg_view *views,
+                         int max_views);
+
+/*
+ * Compare an argument view with a null terminated string.
+ *
+ * Returns true iff they contain the same characters.
+ */
+bool rqshell_arg_view_equals(struct rqshell_arg_view, char const *);
+
+/*
+ * Split a mutable argument line into null terminated arguments in place.
+ * Uses the same field rules as the iterator. At most max_args pointers are
+ * written to argv, each pointing into chs.
+ *
+ * Returns the number of arguments found, or -1 if a field is malformed.
+ */
+int rqshell_arg_split(char *chs, int count, char const **argv, int max_args);
+
+/*
+ * Count the number of arguments that can still be extracted from the iterator.
+ * Uses the same field rules as the iterator.
+ *
+ * Returns -1 if a field is malformed.
  */
 int rqshell_arg_iter_count_args(struct rqshell_arg_iter const *);
 
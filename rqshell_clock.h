@@ -0,0 +1,16 @@
+#ifndef _HEADER_FILE_rqshell_clock_20261017134410_
+#define _HEADER_FILE_rqshell_clock_20261017134410_
+
+#include <time.h>
+
+/*
+ * Monotonic time in nanoseconds, for timing code.
+ */
+static inline unsigned long long rqshell_now_ns(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (unsigned long long)now.tv_sec * 1000000000ull +
+         (unsigned long long)now.tv_nsec;
+}
+
+#endif
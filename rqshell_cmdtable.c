@@ -0,0 +1,122 @@
+#include "rqshell_cmdtable.h"
+#include "rqshell_hash.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define CMDTABLE_MIN_CAPACITY (64)
+
+static inline bool cmdtable_name_equals(struct rqshell_command const *cmd,
+                                        char const *name, int len) {
+  return strncmp(cmd->name, name, len) == 0 && cmd->name[len] == '\0';
+}
+
+static inline struct rqshell_command *
+cmdtable_probe(struct rqshell_command *slots, unsigned capacity,
+               unsigned hash, char const *name, int len) {
+  unsigned mask = capacity - 1;
+  for (unsigned i = hash & mask;; i = (i + 1) & mask) {
+    struct rqshell_command *slot = slots + i;
+    if (!slot->name ||
+        (slot->hash == hash && cmdtable_name_equals(slot, name, len))) {
+      return slot;
+    }
+  }
+}
+
+static bool cmdtable_grow(struct rqshell_cmdtable *table) {
+  unsigned capacity =
+      table->capacity ? table->capacity * 2 : CMDTABLE_MIN_CAPACITY;
+  struct rqshell_command *slots = calloc(capacity, sizeof(*slots));
+  if (!slots) {
+    return false;
+  }
+
+  for (unsigned i = 0; i < table->capacity; ++i) {
+    struct rqshell_command *old = table->slots + i;
+    if (old->name) {
+      *cmdtable_probe(slots, capacity, old->hash, old->name,
+                      (int)strlen(old->name)) = *old;
+    }
+  }
+
+  free(table->slots);
+  table->slots = slots;
+  table->capacity = capacity;
+  return true;
+}
+
+struct rqshell_command *rqshell_cmdtable_insert(struct rqshell_cmdtable *table,
+                                                char const *name) {
+  // keep the load factor below 3/4 so probe sequences stay short
+  if ((table->used + 1) * 4 > table->capacity * 3 && !cmdtable_grow(table)) {
+    return NULL;
+  }
+
+  int len = (int)strlen(name);
+  unsigned hash = rqshell_hash(name, len);
+  struct rqshell_command *slot =
+      cmdtable_probe(table->slots, table->capacity, hash, name, len);
+  if (slot->name) {
+    return NULL; // already registered
+  }
+
+  *slot = (struct rqshell_command){.name = name, .hash = hash};
+  table->used++;
+  table->sorted_valid = false;
+  return slot;
+}
+
+struct rqshell_command *rqshell_cmdtable_find(struct rqshell_cmdtable const *table,
+                                              char const *name, int len) {
+  if (table->used == 0) {
+    return NULL;
+  }
+
+  struct rqshell_command *slot = cmdtable_probe(
+      table->slots, table->capacity, rqshell_hash(name, len), name, len);
+  return slot->name ? slot : NULL;
+}
+
+static int cmdtable_compare(void const *a, void const *b) {
+  struct rqshell_command const *ca = *(struct rqshell_command const **)a;
+  struct rqshell_command const *cb = *(struct rqshell_command const **)b;
+  return strcmp(ca->name, cb->name);
+}
+
+struct rqshell_command const *const *
+rqshell_cmdtable_sorted(struct rqshell_cmdtable *table, unsigned *count) {
+  *count = 0;
+
+  if (!table->sorted_valid) {
+    struct rqshell_command const **sorted =
+        realloc(table->sorted, (table->used + 1) * sizeof(*sorted));
+    if (!sorted) {
+      return NULL;
+    }
+
+    unsigned n = 0;
+    for (unsigned i = 0; i < table->capacity; ++i) {
+      if (table->slots[i].name) {
+        sorted[n++] = table->slots + i;
+      }
+    }
+    qsort(sorted, n, sizeof(*sorted), cmdtable_compare);
+
+    table->sorted = sorted;
+    table->sorted_valid = true;
+  }
+
+  *count = table->used;
+  return table->sorted;
+}
+
+void rqshell_cmdtable_free(struct rqshell_cmdtable *table) {
+  free(table->slots);
+  free(table->sorted);
+  *table = (struct rqshell_cmdtable){0};
+}
+
+size_t rqshell_cmdtable_footprint(struct rqshell_cmdtable const *table) {
+  return table->capacity * sizeof(*table->slots) +
+         (table->sorted ? (table->used + 1) * sizeof(*table->sorted) : 0);
+}
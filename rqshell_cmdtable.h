@@ -0,0 +1,77 @@
+#ifndef _HEADER_FILE_rqshell_cmdtable_20261016113106_
+#define _HEADER_FILE_rqshell_cmdtable_20261016113106_
+
+#include "rqshell.h"
+#include <stdbool.h>
+
+/*
+ * A registered console command.
+ */
+struct rqshell_command {
+  char const *name; // null when the slot is empty
+  unsigned hash;
+  void (*handler)(int, char const *); // raw argument line handler
+  void (*argv_handler)(int, char const **); // pre-tokenized handler
+  enum rqshell_task_status (*task)(struct rqshell_task *, int,
+                                   char const **); // resumable handler
+  void (*async)(struct rqshell_job *, int,
+                char const **); // handler run on a worker thread
+  void (*complete)(struct rqshell_completion *, int,
+                   char const **); // argument completer, may be null
+
+  // time spent in the handler since the last reset
+  unsigned long long calls;
+  unsigned long long total_ns;
+  unsigned long long max_ns;
+};
+
+/*
+ * Command table.
+ * An open addressing hash table keyed by command name, so looking up a command
+ * costs the same no matter how many commands are registered. The table grows
+ * as commands are added.
+ */
+struct rqshell_cmdtable {
+  struct rqshell_command *slots;
+  unsigned capacity; // always zero or a power of two
+  unsigned used;
+
+  struct rqshell_command const **sorted; // commands ordered by name
+  bool sorted_valid; // false when sorted must be rebuilt
+};
+
+/*
+ * Add a command to the table. The name is not copied and must outlive the table.
+ *
+ * Returns the new entry, or a null pointer if the name is already in the
+ * table or memory ran out.
+ */
+struct rqshell_command *rqshell_cmdtable_insert(struct rqshell_cmdtable *,
+                                                char const *name);
+
+/*
+ * Find the command whose name equals the first len characters of name.
+ *
+ * Returns a null pointer if there is no such command.
+ */
+struct rqshell_command *rqshell_cmdtable_find(struct rqshell_cmdtable const *,
+                                              char const *name, int len);
+
+/*
+ * Get all commands ordered by name.
+ * The returned array is valid until the next insertion.
+ */
+struct rqshell_command const *const *
+rqshell_cmdtable_sorted(struct rqshell_cmdtable *, unsigned *count);
+
+/*
+ * Release the memory held by the table.
+ */
+void rqshell_cmdtable_free(struct rqshell_cmdtable *);
+
+/*
+ * Bytes of memory held by the table, including empty slots.
+ */
+size_t rqshell_cmdtable_footprint(struct rqshell_cmdtable const *);
+
+#endif
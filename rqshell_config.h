@@ -2,9 +2,49 @@
 #ifndef _HEADER_FILE_rqshell_config_20230314202817_
 #define _HEADER_FILE_rqshell_config_20230314202817_
 
-#define N_LINES (255)
 #define LINE_SIZE (1024)
-#define N_DECISIONS (255)
+#define N_ARGS (64) // most arguments passed to an argv style command
+
+// default byte budgets, changeable at runtime with
+// rqshell_set_scrollback_limit and rqshell_set_history_limit
+#define SCROLLBACK_LIMIT (4 * 1024 * 1024)
+#define HISTORY_LIMIT (256 * 1024)
+
+// lines that can wait in the rqshell_post queue, must be a power of two
+#define POST_QUEUE_SIZE (256)
+
+// bytes of raylib log lines batched between update steps
+#define LOG_BATCH_SIZE (64 * 1024)
+
+// default time a resumable command may run per update step
+#define TASK_BUDGET_MS (2.0f)
+
+// threads running commands registered with rqshell_register_async,
+// and how many of those commands can be queued or running at once
+#define WORKER_THREADS (2)
+#define WORKER_JOBS (16)
+
+// most threads a recursive directory walk uses, never more than the cores
+#define WALK_THREADS (8)
+
+// most completion candidates listed when tab cannot extend the word,
+// the bytes kept for them, and the width of the listing
+#define COMPLETION_SHOWN (64)
+#define COMPLETION_ARENA (8 * 1024)
+#define COMPLETION_WIDTH (80)
+
+// most values pinned above the prompt by watch, and the longest name watched
+#define WATCH_LIMIT (8)
+#define WATCH_NAME_SIZE (64)
+
+// profiler scopes, threads recording at once, durations kept per scope and
+// thread (a power of two), scopes open at once on a thread, and frames kept
+// for the graph and for the console's own cost
+#define PROF_SCOPES (64)
+#define PROF_THREADS (16)
+#define PROF_SAMPLES (256)
+#define PROF_DEPTH (32)
+#define PROF_FRAMES (240)
 
 #define BACKSPACE_DELETE_FIRST (0.5f)
 #define BACKSPACE_DELETE (0.03f)
@@ -0,0 +1,222 @@
+#include "rqshell_cvars.h"
+#include "rqshell_hash.h"
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#define CVARS_MIN_CAPACITY (64)
+
+static inline bool cvars_name_equals(struct rqshell_cvar const *cvar,
+                                     char const *name, int len) {
+  return strncmp(cvar->name, name, len) == 0 && cvar->name[len] == '\0';
+}
+
+static inline struct rqshell_cvar *cvars_probe(struct rqshell_cvar *slots,
+                                               unsigned capacity,
+                                               unsigned hash, char const *name,
+                                               int len) {
+  unsigned mask = capacity - 1;
+  for (unsigned i = hash & mask;; i = (i + 1) & mask) {
+    struct rqshell_cvar *slot = slots + i;
+    if (!slot->name ||
+        (slot->hash == hash && cvars_name_equals(slot, name, len))) {
+      return slot;
+    }
+  }
+}
+
+static bool cvars_grow(struct rqshell_cvars *table) {
+  unsigned capacity =
+      table->capacity ? table->capacity * 2 : CVARS_MIN_CAPACITY;
+  struct rqshell_cvar *slots = calloc(capacity, sizeof(*slots));
+  if (!slots) {
+    return false;
+  }
+
+  for (unsigned i = 0; i < table->capacity; ++i) {
+    struct rqshell_cvar *old = table->slots + i;
+    if (old->name) {
+      *cvars_probe(slots, capacity, old->hash, old->name,
+                   (int)strlen(old->name)) = *old;
+    }
+  }
+
+  free(table->slots);
+  table->slots = slots;
+  table->capacity = capacity;
+  table->sorted_valid = false; // the sorted pointers point into the old slots
+  return true;
+}
+
+struct rqshell_cvar *rqshell_cvars_insert(struct rqshell_cvars *table,
+                                          char const *name) {
+  // keep the load factor below 3/4 so probe sequences stay short
+  if ((table->used + 1) * 4 > table->capacity * 3 && !cvars_grow(table)) {
+    return NULL;
+  }
+
+  int len = (int)strlen(name);
+  unsigned hash = rqshell_hash(name, len);
+  struct rqshell_cvar *slot =
+      cvars_probe(table->slots, table->capacity, hash, name, len);
+  if (slot->name) {
+    return NULL; // already bound
+  }
+
+  *slot = (struct rqshell_cvar){.name = name, .hash = hash};
+  table->used++;
+  table->sorted_valid = false;
+  return slot;
+}
+
+struct rqshell_cvar *rqshell_cvars_find(struct rqshell_cvars const *table,
+                                        char const *name, int len) {
+  if (table->used == 0) {
+    return NULL;
+  }
+
+  struct rqshell_cvar *slot = cvars_probe(
+      table->slots, table->capacity, rqshell_hash(name, len), name, len);
+  return slot->name ? slot : NULL;
+}
+
+static int cvars_compare(void const *a, void const *b) {
+  struct rqshell_cvar const *ca = *(struct rqshell_cvar const **)a;
+  struct rqshell_cvar const *cb = *(struct rqshell_cvar const **)b;
+  return strcmp(ca->name, cb->name);
+}
+
+struct rqshell_cvar const *const *
+rqshell_cvars_sorted(struct rqshell_cvars *table, unsigned *count) {
+  *count = 0;
+
+  if (!table->sorted_valid) {
+    struct rqshell_cvar const **sorted =
+        realloc(table->sorted, (table->used + 1) * sizeof(*sorted));
+    if (!sorted) {
+      return NULL;
+    }
+
+    unsigned n = 0;
+    for (unsigned i = 0; i < table->capacity; ++i) {
+      if (table->slots[i].name) {
+        sorted[n++] = table->slots + i;
+      }
+    }
+    qsort(sorted, n, sizeof(*sorted), cvars_compare);
+
+    table->sorted = sorted;
+    table->sorted_valid = true;
+  }
+
+  *count = table->used;
+  return table->sorted;
+}
+
+void rqshell_cvars_free(struct rqshell_cvars *table) {
+  free(table->slots);
+  free(table->sorted);
+  *table = (struct rqshell_cvars){0};
+}
+
+size_t rqshell_cvars_footprint(struct rqshell_cvars const *table) {
+  return table->capacity * sizeof(*table->slots) +
+         (table->sorted ? (table->used + 1) * sizeof(*table->sorted) : 0);
+}
+
+static bool cvar_parse_bool(char const *text, bool *out) {
+  static char const *const truths[] = {"1", "true", "on", "yes"};
+  static char const *const lies[] = {"0", "false", "off", "no"};
+  for (size_t i = 0; i < sizeof(truths) / sizeof(*truths); ++i) {
+    if (strcasecmp(text, truths[i]) == 0) {
+      *out = true;
+      return true;
+    }
+    if (strcasecmp(text, lies[i]) == 0) {
+      *out = false;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool rqshell_cvar_parse(struct rqshell_cvar *cvar, char const *text) {
+  char *end = NULL;
+  errno = 0;
+
+  switch (cvar->type) {
+  case RQSHELL_CVAR_FLOAT: {
+    float value = strtof(text, &end);
+    if (end == text || *end != '\0' || errno == ERANGE) {
+      return false;
+    }
+    *(float *)cvar->value = value;
+    return true;
+  }
+  case RQSHELL_CVAR_INT: {
+    long value = strtol(text, &end, 0);
+    if (end == text || *end != '\0' || errno == ERANGE || value < INT_MIN ||
+        value > INT_MAX) {
+      return false;
+    }
+    *(int *)cvar->value = (int)value;
+    return true;
+  }
+  case RQSHELL_CVAR_BOOL:
+    return cvar_parse_bool(text, cvar->value);
+  case RQSHELL_CVAR_STRING: {
+    size_t length = strlen(text);
+    if (length >= cvar->size) {
+      return false;
+    }
+    memcpy(cvar->value, text, length + 1);
+    return true;
+  }
+  }
+  return false;
+}
+
+char const *rqshell_cvar_format(struct rqshell_cvar *cvar) {
+  switch (cvar->type) {
+  case RQSHELL_CVAR_FLOAT: {
+    float value = *(float const *)cvar->value;
+    if (!cvar->shown_valid || memcmp(&cvar->shown.f, &value, sizeof(value))) {
+      snprintf(cvar->text, sizeof(cvar->text), "%g", value);
+      cvar->shown.f = value;
+    }
+    break;
+  }
+  case RQSHELL_CVAR_INT: {
+    int value = *(int const *)cvar->value;
+    if (!cvar->shown_valid || cvar->shown.i != value) {
+      snprintf(cvar->text, sizeof(cvar->text), "%d", value);
+      cvar->shown.i = value;
+    }
+    break;
+  }
+  case RQSHELL_CVAR_BOOL: {
+    return *(bool const *)cvar->value ? "true" : "false";
+  }
+  case RQSHELL_CVAR_STRING:
+    return cvar->value; // already text
+  }
+  cvar->shown_valid = true;
+  return cvar->text;
+}
+
+char const *rqshell_cvar_type_name(enum rqshell_cvar_type type) {
+  switch (type) {
+  case RQSHELL_CVAR_FLOAT:
+    return "float";
+  case RQSHELL_CVAR_INT:
+    return "int";
+  case RQSHELL_CVAR_BOOL:
+    return "bool";
+  case RQSHELL_CVAR_STRING:
+    return "string";
+  }
+  return "?";
+}
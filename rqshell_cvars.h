@@ -0,0 +1,102 @@
+#ifndef _HEADER_FILE_rqshell_cvars_20261017103518_
+#define _HEADER_FILE_rqshell_cvars_20261017103518_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+enum rqshell_cvar_type {
+  RQSHELL_CVAR_FLOAT,
+  RQSHELL_CVAR_INT,
+  RQSHELL_CVAR_BOOL,
+  RQSHELL_CVAR_STRING,
+};
+
+/*
+ * A console variable bound to a value in game memory.
+ */
+struct rqshell_cvar {
+  char const *name; // null when the slot is empty
+  unsigned hash;
+  enum rqshell_cvar_type type;
+  void *value; // the bound value, owned by the game
+  size_t size; // bytes at value for strings
+
+  // the value text was last formatted from, so reading an unchanged
+  // variable does not format it again
+  bool shown_valid;
+  union {
+    float f;
+    int i;
+    bool b;
+  } shown;
+  char text[32];
+};
+
+/*
+ * Console variable table.
+ * An open addressing hash table keyed by name, like the command table.
+ */
+struct rqshell_cvars {
+  struct rqshell_cvar *slots;
+  unsigned capacity; // always zero or a power of two
+  unsigned used;
+
+  struct rqshell_cvar const **sorted; // variables ordered by name
+  bool sorted_valid; // false when sorted must be rebuilt
+};
+
+/*
+ * Add a variable to the table. The name is not copied and must outlive the
+ * table.
+ *
+ * Returns the new entry, or a null pointer if the name is already in the
+ * table or memory ran out.
+ */
+struct rqshell_cvar *rqshell_cvars_insert(struct rqshell_cvars *,
+                                          char const *name);
+
+/*
+ * Find the variable whose name equals the first len characters of name.
+ *
+ * Returns a null pointer if there is no such variable.
+ */
+struct rqshell_cvar *rqshell_cvars_find(struct rqshell_cvars const *,
+                                        char const *name, int len);
+
+/*
+ * Get all variables ordered by name.
+ * The returned array is valid until the next insertion.
+ */
+struct rqshell_cvar const *const *
+rqshell_cvars_sorted(struct rqshell_cvars *, unsigned *count);
+
+/*
+ * Release the memory held by the table. The bound values are not touched.
+ */
+void rqshell_cvars_free(struct rqshell_cvars *);
+
+/*
+ * Bytes of memory held by the table, including empty slots.
+ */
+size_t rqshell_cvars_footprint(struct rqshell_cvars const *);
+
+/*
+ * Parse text according to the type of the variable and store it.
+ *
+ * Returns false, leaving the value as it was, if the text does not parse or a
+ * string does not fit.
+ */
+bool rqshell_cvar_parse(struct rqshell_cvar *, char const *text);
+
+/*
+ * Get the value of the variable as text.
+ * The returned string is valid until the variable is formatted again.
+ */
+char const *rqshell_cvar_format(struct rqshell_cvar *);
+
+/*
+ * Name of a variable type, for listing.
+ */
+char const *rqshell_cvar_type_name(enum rqshell_cvar_type);
+
+#endif
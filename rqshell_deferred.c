@@ -0,0 +1,347 @@
+#include "rqshell_deferred.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define SPEC_SIZE (64)
+
+// The kind of argument a conversion consumes.
+enum arg_class {
+  ARG_NONE,
+  ARG_INT,
+  ARG_LONG,
+  ARG_LLONG,
+  ARG_INTMAX,
+  ARG_SIZE,
+  ARG_PTRDIFF,
+  ARG_DOUBLE,
+  ARG_LDOUBLE,
+  ARG_STRING,
+  ARG_POINTER,
+  ARG_UNSUPPORTED,
+};
+
+struct conversion {
+  char const *start; // the '%'
+  char const *end; // one past the conversion character
+  bool width_star;
+  bool precision_star;
+  int precision; // -1 when not given or given as '*'
+  enum arg_class arg;
+};
+
+static enum arg_class integer_class(char const *length) {
+  if (length[0] == 'l') {
+    return length[1] == 'l' ? ARG_LLONG : ARG_LONG;
+  }
+  switch (length[0]) {
+  case 'j':
+    return ARG_INTMAX;
+  case 'z':
+    return ARG_SIZE;
+  case 't':
+    return ARG_PTRDIFF;
+  default:
+    return ARG_INT; // no length, hh and h are all promoted to int
+  }
+}
+
+// Parse the conversion starting at the '%' in p.
+static void parse_conversion(char const *p, struct conversion *c) {
+  *c = (struct conversion){.start = p, .precision = -1, .arg = ARG_UNSUPPORTED};
+  p++;
+
+  if (*p == '%') {
+    c->arg = ARG_NONE;
+    c->end = p + 1;
+    return;
+  }
+
+  while (*p && strchr("-+ #0'", *p)) {
+    p++;
+  }
+
+  if (*p == '*') {
+    c->width_star = true;
+    p++;
+  } else {
+    while (*p >= '0' && *p <= '9') {
+      p++;
+    }
+  }
+
+  if (*p == '.') {
+    p++;
+    if (*p == '*') {
+      c->precision_star = true;
+      p++;
+    } else {
+      c->precision = 0;
+      while (*p >= '0' && *p <= '9') {
+        c->precision = c->precision * 10 + (*p - '0');
+        p++;
+      }
+    }
+  }
+
+  char const *length = p;
+  while (*p && strchr("hljztL", *p)) {
+    p++;
+  }
+  bool no_length = (length == p);
+
+  switch (*p) {
+  case 'd':
+  case 'i':
+  case 'u':
+  case 'o':
+  case 'x':
+  case 'X':
+    c->arg = integer_class(length);
+    break;
+  case 'c':
+    c->arg = no_length ? ARG_INT : ARG_UNSUPPORTED;
+    break;
+  case 's':
+    c->arg = no_length ? ARG_STRING : ARG_UNSUPPORTED;
+    break;
+  case 'p':
+    c->arg = ARG_POINTER;
+    break;
+  case 'f':
+  case 'F':
+  case 'e':
+  case 'E':
+  case 'g':
+  case 'G':
+  case 'a':
+  case 'A':
+    c->arg = length[0] == 'L' ? ARG_LDOUBLE : ARG_DOUBLE;
+    break;
+  default:
+    c->arg = ARG_UNSUPPORTED; // %n, wide characters and unknown conversions
+    break;
+  }
+
+  c->end = *p ? p + 1 : p;
+}
+
+#define CAPTURE(type, value)                                                   \
+  do {                                                                         \
+    type v = (value);                                                          \
+    if (size + (int)sizeof(v) > cap) {                                         \
+      return -1;                                                               \
+    }                                                                          \
+    memcpy(record + size, &v, sizeof(v));                                      \
+    size += (int)sizeof(v);                                                    \
+  } while (0)
+
+int rqshell_deferred_capture(char *record, int cap, char const *format,
+                             va_list args) {
+  int size = 0;
+  CAPTURE(char const *, format);
+
+  for (char const *p = strchr(format, '%'); p; p = strchr(p, '%')) {
+    struct conversion c;
+    parse_conversion(p, &c);
+    p = c.end;
+
+    int precision = c.precision;
+    if (c.width_star) {
+      CAPTURE(int, va_arg(args, int));
+    }
+    if (c.precision_star) {
+      precision = va_arg(args, int);
+      CAPTURE(int, precision);
+    }
+
+    switch (c.arg) {
+    case ARG_NONE:
+      break;
+    case ARG_INT:
+      CAPTURE(int, va_arg(args, int));
+      break;
+    case ARG_LONG:
+      CAPTURE(long, va_arg(args, long));
+      break;
+    case ARG_LLONG:
+      CAPTURE(long long, va_arg(args, long long));
+      break;
+    case ARG_INTMAX:
+      CAPTURE(intmax_t, va_arg(args, intmax_t));
+      break;
+    case ARG_SIZE:
+      CAPTURE(size_t, va_arg(args, size_t));
+      break;
+    case ARG_PTRDIFF:
+      CAPTURE(ptrdiff_t, va_arg(args, ptrdiff_t));
+      break;
+    case ARG_DOUBLE:
+      CAPTURE(double, va_arg(args, double));
+      break;
+    case ARG_LDOUBLE:
+      CAPTURE(long double, va_arg(args, long double));
+      break;
+    case ARG_POINTER:
+      CAPTURE(void *, va_arg(args, void *));
+      break;
+    case ARG_STRING: {
+      char const *s = va_arg(args, char const *);
+      if (!s) {
+        s = "(null)";
+      }
+      // only the characters the precision lets through are needed
+      int len = (int)(precision >= 0 ? strnlen(s, precision) : strlen(s));
+      CAPTURE(int, len);
+      if (size + len + 1 > cap) {
+        return -1;
+      }
+      memcpy(record + size, s, len);
+      record[size + len] = '\0';
+      size += len + 1;
+      break;
+    }
+    default:
+      return -1;
+    }
+  }
+
+  return size;
+}
+
+#define RESTORE(type, name)                                                    \
+  type name;                                                                   \
+  memcpy(&name, record + size, sizeof(name));                                  \
+  size += (int)sizeof(name)
+
+// Copy the conversion into spec with any '*' replaced by its captured value.
+static void build_spec(char *spec, struct conversion const *c, int width,
+                       int precision) {
+  int n = 0;
+  for (char const *p = c->start; p < c->end && n < SPEC_SIZE - 12; ++p) {
+    if (*p == '*') {
+      bool is_width = (p == c->start + 1 || p[-1] != '.');
+      n += snprintf(spec + n, SPEC_SIZE - n, "%d", is_width ? width : precision);
+    } else {
+      spec[n++] = *p;
+    }
+  }
+  spec[n] = '\0';
+}
+
+int rqshell_deferred_format(char *out, int cap, char const *record, int len) {
+  int size = 0;
+  int pos = 0;
+
+  if (cap <= 0) {
+    return 0;
+  }
+  if (len < (int)sizeof(char const *)) {
+    out[0] = '\0';
+    return 0;
+  }
+
+  RESTORE(char const *, format);
+
+  char const *p = format;
+  while (*p && pos < cap - 1) {
+    char const *next = strchr(p, '%');
+    int literal = next ? (int)(next - p) : (int)strlen(p);
+    if (literal > cap - 1 - pos) {
+      literal = cap - 1 - pos;
+    }
+    memcpy(out + pos, p, literal);
+    pos += literal;
+    if (!next) {
+      break;
+    }
+
+    struct conversion c;
+    parse_conversion(next, &c);
+    p = c.end;
+
+    int width = 0, precision = 0;
+    if (c.width_star) {
+      RESTORE(int, w);
+      width = w;
+    }
+    if (c.precision_star) {
+      RESTORE(int, pr);
+      precision = pr;
+    }
+
+    char spec[SPEC_SIZE];
+    build_spec(spec, &c, width, precision);
+
+    int room = cap - pos;
+    int written = 0;
+    switch (c.arg) {
+    case ARG_NONE:
+      written = snprintf(out + pos, room, "%%");
+      break;
+    case ARG_INT: {
+      RESTORE(int, v);
+      written = snprintf(out + pos, room, spec, v);
+      break;
+    }
+    case ARG_LONG: {
+      RESTORE(long, v);
+      written = snprintf(out + pos, room, spec, v);
+      break;
+    }
+    case ARG_LLONG: {
+      RESTORE(long long, v);
+      written = snprintf(out + pos, room, spec, v);
+      break;
+    }
+    case ARG_INTMAX: {
+      RESTORE(intmax_t, v);
+      written = snprintf(out + pos, room, spec, v);
+      break;
+    }
+    case ARG_SIZE: {
+      RESTORE(size_t, v);
+      written = snprintf(out + pos, room, spec, v);
+      break;
+    }
+    case ARG_PTRDIFF: {
+      RESTORE(ptrdiff_t, v);
+      written = snprintf(out + pos, room, spec, v);
+      break;
+    }
+    case ARG_DOUBLE: {
+      RESTORE(double, v);
+      written = snprintf(out + pos, room, spec, v);
+      break;
+    }
+    case ARG_LDOUBLE: {
+      RESTORE(long double, v);
+      written = snprintf(out + pos, room, spec, v);
+      break;
+    }
+    case ARG_POINTER: {
+      RESTORE(void *, v);
+      written = snprintf(out + pos, room, spec, v);
+      break;
+    }
+    case ARG_STRING: {
+      RESTORE(int, n);
+      written = snprintf(out + pos, room, spec, record + size);
+      size += n + 1;
+      break;
+    }
+    default:
+      written = 0;
+      break;
+    }
+
+    if (written > 0) {
+      pos += written < room ? written : room - 1;
+    }
+  }
+
+  out[pos] = '\0';
+  return pos;
+}
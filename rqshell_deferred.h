@@ -0,0 +1,33 @@
+#ifndef _HEADER_FILE_rqshell_deferred_20261016153417_
+#define _HEADER_FILE_rqshell_deferred_20261016153417_
+
+#include <stdarg.h>
+
+/*
+ * Deferred formatting.
+ * Instead of formatting a printf style line right away, the format pointer
+ * and the raw bytes of the arguments are captured into a compact record,
+ * which is formatted later when the line is actually read.
+ *
+ * The format string is not copied and must outlive the record, which is
+ * the case for string literals. Strings passed for %s are copied.
+ * Wide character conversions and %n are not supported.
+ */
+
+/*
+ * Capture a format string and its arguments into a record of at most cap bytes.
+ *
+ * Returns the size of the record, or -1 if the format is not supported or the
+ * record does not fit.
+ */
+int rqshell_deferred_capture(char *record, int cap, char const *format,
+                             va_list args);
+
+/*
+ * Format a captured record into a null terminated string of at most cap bytes.
+ *
+ * Returns the length of the formatted string.
+ */
+int rqshell_deferred_format(char *out, int cap, char const *record, int len);
+
+#endif
@@ -0,0 +1,16 @@
+#ifndef _HEADER_FILE_rqshell_hash_20261016113040_
+#define _HEADER_FILE_rqshell_hash_20261016113040_
+
+/*
+ * FNV-1a hash of len characters.
+ */
+static inline unsigned rqshell_hash(char const *chrs, int len) {
+  unsigned hash = 2166136261u;
+  for (int i = 0; i < len; ++i) {
+    hash ^= (unsigned char)chrs[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+#endif
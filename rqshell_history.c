@@ -0,0 +1,434 @@
+#define _GNU_SOURCE // memrchr
+#include "rqshell_history.h"
+#include "rqshell_hash.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define HISTORY_MIN_KEPT (256)
+
+struct history_entry {
+  size_t offset;
+  size_t length;
+};
+
+static void history_unmap(struct rqshell_history *history) {
+  if (history->map) {
+    munmap((void *)history->map, history->map_size);
+  }
+  history->map = NULL;
+  history->map_size = 0;
+  history->memo_valid = false;
+}
+
+static void history_close(struct rqshell_history *history) {
+  history_unmap(history);
+  if (history->fd >= 0) {
+    close(history->fd);
+  }
+  history->fd = -1;
+  free(history->path);
+  history->path = NULL;
+  history->file_size = 0;
+}
+
+// Map the file as it is now. Everything entered so far is in the file then,
+// so the in memory entries are dropped.
+static bool history_map(struct rqshell_history *history) {
+  history_unmap(history);
+
+  struct stat st;
+  if (fstat(history->fd, &st) != 0) {
+    return false;
+  }
+  history->file_size = (size_t)st.st_size;
+
+  if (history->file_size > 0) {
+    void *map = mmap(NULL, history->file_size, PROT_READ, MAP_PRIVATE,
+                     history->fd, 0);
+    if (map == MAP_FAILED) {
+      return false;
+    }
+    history->map = map;
+    history->map_size = history->file_size;
+  }
+
+  rqshell_lines_clear(&history->recent);
+  rqshell_trigram_free(&history->index);
+  history->indexed = false;
+  return true;
+}
+
+// Map the file again to take in the commands appended to it. The file
+// holds the same entries as before, so the search index stays valid.
+static void history_remap(struct rqshell_history *history) {
+  struct rqshell_trigram_index index = history->index;
+  bool indexed = history->indexed;
+  history->index = (struct rqshell_trigram_index){0};
+  if (history_map(history)) {
+    history->index = index;
+    history->indexed = indexed;
+  } else {
+    rqshell_trigram_free(&index);
+    history->indexed = false;
+  }
+}
+
+static void history_append(struct rqshell_history *history, char const *command,
+                           size_t length) {
+  char line[LINE_SIZE + 1];
+  memcpy(line, command, length);
+  for (size_t i = 0; i < length; ++i) {
+    if (line[i] == '\n') {
+      line[i] = ' '; // one command per line
+    }
+  }
+  line[length] = '\n';
+
+  if (write(history->fd, line, length + 1) == (ssize_t)(length + 1)) {
+    history->file_size += length + 1;
+  }
+}
+
+// Find the entry that ends at end, the offset of its terminating newline
+// or the end of the data.
+static struct history_entry history_entry_ending(char const *data, size_t end) {
+  char const *nl = end > 0 ? memrchr(data, '\n', end) : NULL;
+  size_t start = nl ? (size_t)(nl - data) + 1 : 0;
+  return (struct history_entry){.offset = start, .length = end - start};
+}
+
+static bool history_newest(char const *data, size_t size,
+                           struct history_entry *entry) {
+  if (size == 0) {
+    return false;
+  }
+  size_t end = data[size - 1] == '\n' ? size - 1 : size;
+  *entry = history_entry_ending(data, end);
+  return true;
+}
+
+static bool history_older(char const *data, struct history_entry *entry) {
+  if (entry->offset == 0) {
+    return false;
+  }
+  *entry = history_entry_ending(data, entry->offset - 1);
+  return true;
+}
+
+static bool history_newer(char const *data, size_t size,
+                          struct history_entry *entry) {
+  size_t start = entry->offset + entry->length + 1;
+  if (start >= size) {
+    return false;
+  }
+  char const *nl = memchr(data + start, '\n', size - start);
+  size_t end = nl ? (size_t)(nl - data) : size;
+  *entry = (struct history_entry){.offset = start, .length = end - start};
+  return true;
+}
+
+// Find the entry of the mapping at the given age, starting from the last
+// entry looked up when that is closer than the end.
+static bool history_map_entry(struct rqshell_history *history, unsigned age,
+                              struct history_entry *entry) {
+  unsigned at;
+  if (history->memo_valid && (age >= history->memo_age ||
+                              history->memo_age - age < age)) {
+    at = history->memo_age;
+    *entry = (struct history_entry){.offset = history->memo_offset,
+                                    .length = history->memo_length};
+  } else if (history_newest(history->map, history->map_size, entry)) {
+    at = 0;
+  } else {
+    return false;
+  }
+
+  for (; at < age; ++at) {
+    if (!history_older(history->map, entry)) {
+      return false;
+    }
+  }
+  for (; at > age; --at) {
+    history_newer(history->map, history->map_size, entry);
+  }
+
+  history->memo_valid = true;
+  history->memo_age = age;
+  history->memo_offset = entry->offset;
+  history->memo_length = entry->length;
+  return true;
+}
+
+static bool history_kept_contains(char const *data,
+                                  struct history_entry const *kept,
+                                  unsigned const *slots, size_t mask,
+                                  struct history_entry entry, unsigned hash,
+                                  size_t *slot) {
+  for (*slot = hash & mask; slots[*slot]; *slot = (*slot + 1) & mask) {
+    struct history_entry const *other = kept + slots[*slot] - 1;
+    if (other->length == entry.length &&
+        memcmp(data + other->offset, data + entry.offset, entry.length) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Rewrite the file with the newest unique entries that fit the byte limit,
+// oldest first. The new file replaces the old one in a single rename.
+static bool history_compact(struct rqshell_history *history) {
+  if (!history_map(history)) {
+    return false;
+  }
+  char const *data = history->map;
+  size_t size = history->map_size;
+
+  size_t cap = HISTORY_MIN_KEPT;
+  struct history_entry *kept = malloc(cap * sizeof(*kept));
+  unsigned *slots = calloc(cap * 2, sizeof(*slots)); // kept index plus one
+  size_t count = 0, bytes = 0;
+  bool ok = kept && slots;
+
+  struct history_entry entry;
+  bool more = ok && history_newest(data, size, &entry);
+  for (; more; more = history_older(data, &entry)) {
+    if (entry.length == 0) {
+      continue;
+    }
+    if (bytes + entry.length + 1 > history->limit) {
+      break;
+    }
+
+    size_t slot;
+    unsigned hash = rqshell_hash(data + entry.offset, (int)entry.length);
+    if (history_kept_contains(data, kept, slots, cap * 2 - 1, entry, hash,
+                              &slot)) {
+      continue;
+    }
+
+    if (count == cap) {
+      // grow both arrays and hash the kept entries again
+      struct history_entry *grown = realloc(kept, cap * 2 * sizeof(*kept));
+      unsigned *rehashed = calloc(cap * 4, sizeof(*rehashed));
+      if (!grown || !rehashed) {
+        kept = grown ? grown : kept;
+        free(rehashed);
+        ok = false;
+        break;
+      }
+      kept = grown;
+      free(slots);
+      slots = rehashed;
+      cap *= 2;
+      for (size_t i = 0; i < count; ++i) {
+        size_t s;
+        history_kept_contains(
+            data, kept, slots, cap * 2 - 1, kept[i],
+            rqshell_hash(data + kept[i].offset, (int)kept[i].length), &s);
+        slots[s] = (unsigned)i + 1;
+      }
+      history_kept_contains(data, kept, slots, cap * 2 - 1, entry, hash, &slot);
+    }
+
+    kept[count] = entry;
+    slots[slot] = (unsigned)++count;
+    bytes += entry.length + 1;
+  }
+
+  size_t path_len = strlen(history->path);
+  char *temp = ok ? malloc(path_len + sizeof(".tmp")) : NULL;
+  FILE *out = NULL;
+  if (temp) {
+    memcpy(temp, history->path, path_len);
+    memcpy(temp + path_len, ".tmp", sizeof(".tmp"));
+    out = fopen(temp, "wb");
+  }
+
+  ok = out != NULL;
+  for (size_t i = count; ok && i-- > 0;) {
+    ok = fwrite(data + kept[i].offset, 1, kept[i].length, out) ==
+             kept[i].length &&
+         fputc('\n', out) != EOF;
+  }
+  if (out) {
+    ok = fclose(out) == 0 && ok;
+    ok = ok && rename(temp, history->path) == 0;
+    if (!ok) {
+      remove(temp);
+    }
+  }
+
+  free(temp);
+  free(kept);
+  free(slots);
+
+  if (ok) {
+    // the old descriptor still points to the replaced file
+    int fd = open(history->path, O_RDWR | O_APPEND);
+    if (fd >= 0) {
+      close(history->fd);
+      history->fd = fd;
+    }
+    history_map(history);
+  }
+  history->compact_failed = !ok;
+  return ok;
+}
+
+struct rqshell_history rqshell_history_init(size_t limit) {
+  return (struct rqshell_history){
+      .recent = rqshell_lines_init(limit),
+      .limit = limit,
+      .fd = -1,
+  };
+}
+
+void rqshell_history_free(struct rqshell_history *history) {
+  history_close(history);
+  rqshell_lines_free(&history->recent);
+  rqshell_trigram_free(&history->index);
+  history->indexed = false;
+}
+
+bool rqshell_history_open(struct rqshell_history *history, char const *path) {
+  history_close(history);
+
+  int fd = open(path, O_RDWR | O_CREAT | O_APPEND, 0644);
+  if (fd < 0) {
+    return false;
+  }
+  // compacting writes next to the file later on, after cd may have changed
+  // the working directory, so keep where it is rather than how it was named
+  history->path = realpath(path, NULL);
+  history->fd = fd;
+  history->compact_failed = false;
+  if (!history->path) {
+    history_close(history);
+    return false;
+  }
+
+  // commands entered before the file was opened go into it as well
+  for (unsigned i = rqshell_lines_count(&history->recent); i-- > 0;) {
+    char const *command = rqshell_lines_get(&history->recent, i);
+    history_append(history, command, strlen(command));
+  }
+
+  if (!history_map(history)) {
+    history_close(history);
+    return false;
+  }
+
+  if (history->file_size > 2 * history->limit) {
+    history_compact(history);
+  }
+  return true;
+}
+
+void rqshell_history_add(struct rqshell_history *history,
+                         char const *command) {
+  size_t length = strnlen(command, LINE_SIZE - 1);
+  if (length == 0) {
+    return;
+  }
+
+  size_t newest_length;
+  char const *newest = rqshell_history_get(history, 0, &newest_length);
+  if (newest && newest_length == length &&
+      memcmp(newest, command, length) == 0) {
+    return;
+  }
+
+  if (history->fd >= 0 &&
+      rqshell_lines_bytes(&history->recent) + length + 1 +
+              sizeof(struct rqshell_line_ref) >
+          history->limit) {
+    // the commands of this run would start dropping out of memory, but they
+    // are all in the file, so map it again to keep them reachable
+    history_remap(history);
+  }
+
+  rqshell_lines_pushn(&history->recent, command, (int)length);
+  if (history->indexed) {
+    rqshell_trigram_add(&history->index, command, length);
+  }
+
+  if (history->fd >= 0) {
+    history_append(history, command, length);
+    if (history->file_size > 2 * history->limit && !history->compact_failed) {
+      history_compact(history);
+    }
+  }
+}
+
+char const *rqshell_history_get(struct rqshell_history *history,
+                                unsigned index, size_t *length) {
+  unsigned recent = rqshell_lines_count(&history->recent);
+  if (index < recent) {
+    char const *command = rqshell_lines_get(&history->recent, index);
+    *length = strlen(command);
+    return command;
+  }
+
+  struct history_entry entry;
+  if (!history_map_entry(history, index - recent, &entry)) {
+    return NULL;
+  }
+  *length = entry.length;
+  return history->map + entry.offset;
+}
+
+struct rqshell_trigram_index const *
+rqshell_history_index(struct rqshell_history *history) {
+  if (history->indexed) {
+    return &history->index;
+  }
+
+  // walk from the newest entry to the oldest, then index oldest first
+  struct {
+    char const *text;
+    size_t length;
+  } *all = NULL;
+  unsigned count = 0, cap = 0;
+  size_t length;
+  char const *entry;
+  while ((entry = rqshell_history_get(history, count, &length))) {
+    if (count == cap) {
+      cap = cap ? cap * 2 : HISTORY_MIN_KEPT;
+      void *grown = realloc(all, cap * sizeof(*all));
+      if (!grown) {
+        break;
+      }
+      all = grown;
+    }
+    all[count].text = entry;
+    all[count++].length = length;
+  }
+
+  rqshell_trigram_free(&history->index);
+  for (unsigned i = count; i-- > 0;) {
+    rqshell_trigram_add(&history->index, all[i].text, all[i].length);
+  }
+  free(all);
+
+  history->indexed = true;
+  return &history->index;
+}
+
+void rqshell_history_set_limit(struct rqshell_history *history, size_t limit) {
+  history->limit = limit;
+  if (history->fd >= 0) {
+    history_remap(history);
+  }
+  rqshell_lines_set_limit(&history->recent, limit);
+}
+
+size_t rqshell_history_footprint(struct rqshell_history const *history) {
+  return rqshell_lines_footprint(&history->recent) +
+         rqshell_trigram_footprint(&history->index) +
+         (history->path ? strlen(history->path) + 1 : 0);
+}
@@ -0,0 +1,96 @@
+#ifndef _HEADER_FILE_rqshell_history_20261016210248_
+#define _HEADER_FILE_rqshell_history_20261016210248_
+
+#include "rqshell_lines.h"
+#include "rqshell_trigram.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Command history.
+ * Commands entered in this run are kept in memory. When a history file is
+ * set, each command is also appended to it, and the commands of earlier runs
+ * are read straight from the file, which is memory mapped when it is opened.
+ * Nothing is parsed up front: older entries are found by scanning backwards
+ * from the end of the mapping as they are asked for.
+ *
+ * The file is only ever appended to. When it grows past twice the byte limit
+ * it is compacted, keeping the newest unique commands that fit the limit.
+ */
+struct rqshell_history {
+  struct rqshell_lines recent; // commands entered since the file was opened
+  size_t limit;
+
+  char *path; // null when the history is not persisted
+  int fd; // the history file opened for appending, -1 when not persisted
+  char const *map; // the file as it was when opened
+  size_t map_size;
+  size_t file_size; // bytes in the file, including the ones appended
+  bool compact_failed; // do not try again in this run
+
+  // the last entry looked up in the mapping, so stepping through it only
+  // scans one entry at a time
+  bool memo_valid;
+  unsigned memo_age; // 0 is the newest entry of the mapping
+  size_t memo_offset;
+  size_t memo_length;
+
+  // substring index over all entries, oldest first, built on first use
+  struct rqshell_trigram_index index;
+  bool indexed;
+};
+
+/*
+ * Create an empty history that keeps at most limit bytes of commands.
+ */
+struct rqshell_history rqshell_history_init(size_t limit);
+
+/*
+ * Close the history file and release the memory held by the history.
+ * The file is not compacted here, adding an entry already does that once
+ * the file grows past twice the byte limit.
+ */
+void rqshell_history_free(struct rqshell_history *);
+
+/*
+ * Persist the history in the file at path, creating it if needed,
+ * and make the commands already in the file available.
+ *
+ * Returns false if the file could not be opened or mapped.
+ */
+bool rqshell_history_open(struct rqshell_history *, char const *path);
+
+/*
+ * Add a command as the newest entry, unless it repeats the newest entry.
+ */
+void rqshell_history_add(struct rqshell_history *, char const *command);
+
+/*
+ * Get the entry at the given age, where 0 is the newest entry, and its length.
+ * Entries read from the file are not null terminated.
+ *
+ * Returns a null pointer if there is no entry at that age.
+ */
+char const *rqshell_history_get(struct rqshell_history *, unsigned index,
+                                size_t *length);
+
+/*
+ * Get the search index over all entries, building it on first use.
+ * The index is kept up to date as entries are added. Entry numbers are only
+ * valid until the history file is opened or compacted, which rebuilds it.
+ */
+struct rqshell_trigram_index const *
+rqshell_history_index(struct rqshell_history *);
+
+/*
+ * Change the byte limit.
+ */
+void rqshell_history_set_limit(struct rqshell_history *, size_t limit);
+
+/*
+ * Bytes of heap memory held by the history and its search index.
+ * The mapping of the history file is not counted, see map_size.
+ */
+size_t rqshell_history_footprint(struct rqshell_history const *);
+
+#endif
@@ -0,0 +1,267 @@
+#define _GNU_SOURCE // memmem
+#include "rqshell_lines.h"
+#include "rqshell_deferred.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define LINES_MIN_DATA (4096)
+#define LINES_MIN_INDEX (64)
+#define LINES_FORMATTED (64) // cached formatted deferred lines, power of two
+
+static inline struct rqshell_line_ref *
+lines_ref(struct rqshell_lines const *lines, unsigned slot) {
+  return &lines->index[(lines->first + slot) & (lines->index_cap - 1)];
+}
+
+static inline size_t lines_entry_size(size_t length) {
+  return length + 1 + sizeof(struct rqshell_line_ref);
+}
+
+static inline void lines_evict_oldest(struct rqshell_lines *lines) {
+  if (lines->used == 0) {
+    return;
+  }
+  struct rqshell_line_ref *oldest = lines_ref(lines, 0);
+  lines->data_begin = oldest->offset + oldest->length + 1;
+  lines->first = (lines->first + 1) & (lines->index_cap - 1);
+  lines->used--;
+
+  if (lines->used == 0) {
+    lines->data_begin = lines->data_end = 0;
+  }
+}
+
+static bool lines_reserve_index(struct rqshell_lines *lines) {
+  if (lines->used < lines->index_cap) {
+    return true;
+  }
+
+  unsigned cap = lines->index_cap ? lines->index_cap * 2 : LINES_MIN_INDEX;
+  struct rqshell_line_ref *index =
+      realloc(lines->index, cap * sizeof(struct rqshell_line_ref));
+  if (!index) {
+    return false;
+  }
+
+  // unwrap the part of the ring that wrapped around the old end
+  if (lines->used > 0 && lines->first + lines->used > lines->index_cap) {
+    unsigned wrapped = lines->first + lines->used - lines->index_cap;
+    memcpy(index + lines->index_cap, index,
+           wrapped * sizeof(struct rqshell_line_ref));
+  }
+
+  lines->index = index;
+  lines->index_cap = cap;
+  return true;
+}
+
+static bool lines_reserve_data(struct rqshell_lines *lines, size_t size) {
+  if (lines->data_end + size <= lines->data_cap) {
+    return true;
+  }
+
+  size_t live = lines->data_end - lines->data_begin;
+
+  // compact when at least half the arena is evicted text, so every byte
+  // is moved at most once per byte appended
+  if (lines->data_begin >= live && live + size <= lines->data_cap) {
+    memmove(lines->data, lines->data + lines->data_begin, live);
+    for (unsigned i = 0; i < lines->used; ++i) {
+      lines_ref(lines, i)->offset -= lines->data_begin;
+    }
+    lines->data_begin = 0;
+    lines->data_end = live;
+    return true;
+  }
+
+  size_t cap = lines->data_cap ? lines->data_cap * 2 : LINES_MIN_DATA;
+  while (cap < lines->data_end + size) {
+    cap *= 2;
+  }
+
+  char *data = realloc(lines->data, cap);
+  if (!data) {
+    return false;
+  }
+  lines->data = data;
+  lines->data_cap = cap;
+  return true;
+}
+
+struct rqshell_lines rqshell_lines_init(size_t limit) {
+  return (struct rqshell_lines){.limit = limit};
+}
+
+void rqshell_lines_free(struct rqshell_lines *lines) {
+  free(lines->data);
+  free(lines->index);
+  free(lines->formatted);
+  *lines = rqshell_lines_init(lines->limit);
+}
+
+void rqshell_lines_push(struct rqshell_lines *lines, char const *text) {
+  rqshell_lines_pushn(lines, text, (int)strnlen(text, LINE_SIZE - 1));
+}
+
+static void lines_append(struct rqshell_lines *lines, char const *bytes,
+                         size_t length, bool deferred) {
+  // always keep the new line, even if it alone is over the limit
+  while (lines->used > 0 &&
+         rqshell_lines_bytes(lines) + lines_entry_size(length) > lines->limit) {
+    lines_evict_oldest(lines);
+  }
+
+  if (!lines_reserve_index(lines) || !lines_reserve_data(lines, length + 1)) {
+    return;
+  }
+
+  char *slot = lines->data + lines->data_end;
+  memcpy(slot, bytes, length);
+  slot[length] = '\0';
+
+  lines->used++;
+  lines->pushed++;
+  *lines_ref(lines, lines->used - 1) = (struct rqshell_line_ref){
+      .offset = lines->data_end, .length = length, .deferred = deferred};
+  lines->data_end += length + 1;
+}
+
+void rqshell_lines_pushn(struct rqshell_lines *lines, char const *text,
+                         int len) {
+  size_t length = len < 0 ? 0 : (size_t)len;
+  if (length > LINE_SIZE - 1) {
+    length = LINE_SIZE - 1;
+  }
+  lines_append(lines, text, length, false);
+}
+
+void rqshell_lines_push_deferred(struct rqshell_lines *lines,
+                                 char const *record, int len) {
+  if (len < 0 || len > LINE_SIZE) {
+    return;
+  }
+  lines_append(lines, record, (size_t)len, true);
+}
+
+void rqshell_lines_pop(struct rqshell_lines *lines) {
+  if (lines->used == 0) {
+    return;
+  }
+  lines->data_end = lines_ref(lines, lines->used - 1)->offset;
+  lines->used--;
+
+  // the next line added gets the same sequence number, so forget the
+  // formatted text cached for the popped one
+  if (lines->formatted) {
+    lines->formatted[lines->pushed & (LINES_FORMATTED - 1)].sequence = 0;
+  }
+  lines->pushed--;
+
+  if (lines->used == 0) {
+    lines->first = 0;
+    lines->data_begin = lines->data_end = 0;
+  }
+}
+
+char const *rqshell_lines_get(struct rqshell_lines *lines, unsigned index) {
+  if (index >= lines->used) {
+    return "";
+  }
+
+  struct rqshell_line_ref *ref = lines_ref(lines, lines->used - 1 - index);
+  if (!ref->deferred) {
+    return lines->data + ref->offset;
+  }
+
+  if (!lines->formatted) {
+    lines->formatted = calloc(LINES_FORMATTED, sizeof(*lines->formatted));
+    if (!lines->formatted) {
+      return "";
+    }
+  }
+
+  unsigned long long sequence = lines->pushed - index;
+  struct rqshell_formatted_line *cached =
+      lines->formatted + (sequence & (LINES_FORMATTED - 1));
+  if (cached->sequence != sequence) {
+    rqshell_deferred_format(cached->text, LINE_SIZE, lines->data + ref->offset,
+                            (int)ref->length);
+    cached->sequence = sequence;
+  }
+  return cached->text;
+}
+
+unsigned long long rqshell_lines_newest(struct rqshell_lines const *lines) {
+  return lines->pushed;
+}
+
+void rqshell_lines_search(struct rqshell_lines *lines, char const *pattern,
+                          int length, unsigned long long from,
+                          void (*f)(unsigned long long number, void *user),
+                          void *user) {
+  if (length <= 0 || lines->used == 0) {
+    return;
+  }
+  unsigned long long oldest = lines->pushed - lines->used + 1;
+  if (from < oldest) {
+    from = oldest;
+  }
+
+  // the next match in the arena, found from the start of an earlier line;
+  // lines before it need no look, and it is only searched for again once the
+  // lines pass it
+  char const *end = lines->data + lines->data_end;
+  char const *hit = NULL;
+
+  for (unsigned long long number = from; number <= lines->pushed; ++number) {
+    struct rqshell_line_ref const *ref =
+        lines_ref(lines, (unsigned)(number - oldest));
+    char const *text = lines->data + ref->offset;
+
+    if (ref->deferred) {
+      char formatted[LINE_SIZE];
+      rqshell_deferred_format(formatted, LINE_SIZE, text, (int)ref->length);
+      if (memmem(formatted, strlen(formatted), pattern, length)) {
+        f(number, user);
+      }
+      continue;
+    }
+
+    if (!hit || hit < text) {
+      hit = memmem(text, end - text, pattern, length);
+      if (!hit) {
+        hit = end; // no match in the remaining text, only deferred lines left
+      }
+    }
+    if (hit < text + ref->length) {
+      f(number, user);
+    }
+  }
+}
+
+unsigned rqshell_lines_count(struct rqshell_lines const *lines) {
+  return lines->used;
+}
+
+size_t rqshell_lines_bytes(struct rqshell_lines const *lines) {
+  return (lines->data_end - lines->data_begin) +
+         lines->used * sizeof(struct rqshell_line_ref);
+}
+
+size_t rqshell_lines_footprint(struct rqshell_lines const *lines) {
+  return lines->data_cap + lines->index_cap * sizeof(*lines->index) +
+         (lines->formatted ? LINES_FORMATTED * sizeof(*lines->formatted) : 0);
+}
+
+void rqshell_lines_set_limit(struct rqshell_lines *lines, size_t limit) {
+  lines->limit = limit;
+  while (lines->used > 0 && rqshell_lines_bytes(lines) > lines->limit) {
+    lines_evict_oldest(lines);
+  }
+}
+
+void rqshell_lines_clear(struct rqshell_lines *lines) {
+  lines->first = 0;
+  lines->used = 0;
+  lines->data_begin = lines->data_end = 0;
+}
@@ -0,0 +1,140 @@
+#ifndef _HEADER_FILE_rqshell_lines_20261016101512_
+#define _HEADER_FILE_rqshell_lines_20261016101512_
+
+#include "rqshell_config.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Location of a single line inside the line arena.
+ */
+struct rqshell_line_ref {
+  size_t offset; // offset of the first character in the arena
+  unsigned length; // character count, not counting the terminating null
+  bool deferred; // the line is a record for rqshell_deferred_format
+};
+
+/*
+ * A deferred line formatted for reading.
+ */
+struct rqshell_formatted_line {
+  unsigned long long sequence; // sequence number of the line plus one, 0 if unused
+  char text[LINE_SIZE];
+};
+
+/*
+ * Console line buffer.
+ * Lines are packed back to back as null terminated strings in a growable
+ * arena, and a ring of offsets indexes them from oldest to newest. When the
+ * stored lines exceed the byte limit the oldest lines are evicted, so adding
+ * a line only costs the length of that line.
+ * Lines are addressed by age: index 0 is the newest line.
+ *
+ * A line can also be stored as a deferred formatting record, which is only
+ * formatted when the line is read. A few formatted lines are cached.
+ */
+struct rqshell_lines {
+  char *data; // the arena
+  size_t data_begin; // offset of the oldest stored line
+  size_t data_end; // offset one past the newest stored line
+  size_t data_cap;
+
+  struct rqshell_line_ref *index; // ring of line locations, oldest first
+  unsigned first; // ring slot of the oldest line
+  unsigned used; // number of lines currently stored
+  unsigned index_cap; // ring capacity, always a power of two
+
+  size_t limit; // byte budget for the text and index together
+
+  unsigned long long pushed; // lines ever added, used to number the lines
+  struct rqshell_formatted_line *formatted; // direct mapped by sequence number
+};
+
+/*
+ * Create an empty line buffer that holds at most limit bytes.
+ * No memory is allocated until the first line is added.
+ */
+struct rqshell_lines rqshell_lines_init(size_t limit);
+
+/*
+ * Release the memory held by the line buffer.
+ */
+void rqshell_lines_free(struct rqshell_lines *);
+
+/*
+ * Add a line as the newest line, evicting the oldest lines if the byte limit
+ * would be exceeded. At most LINE_SIZE - 1 characters of the text are stored.
+ */
+void rqshell_lines_push(struct rqshell_lines *, char const *text);
+
+/*
+ * Same as rqshell_lines_push, but the text is given with an explicit length
+ * and does not need to be null terminated.
+ */
+void rqshell_lines_pushn(struct rqshell_lines *, char const *text, int len);
+
+/*
+ * Add a record made by rqshell_deferred_capture as the newest line.
+ * At most LINE_SIZE bytes of record are accepted.
+ */
+void rqshell_lines_push_deferred(struct rqshell_lines *, char const *record,
+                                 int len);
+
+/*
+ * Remove the newest line.
+ */
+void rqshell_lines_pop(struct rqshell_lines *);
+
+/*
+ * Get the line at the given age, where 0 is the newest line.
+ * Deferred lines are formatted here, on first read.
+ * Returns an empty string if no line is stored at that age.
+ * The returned string is valid until the next line is added or read.
+ */
+char const *rqshell_lines_get(struct rqshell_lines *, unsigned index);
+
+/*
+ * Number of the newest line. Lines are numbered from 1 in the order they are
+ * added, so the line at age i is numbered rqshell_lines_newest() - i, and a
+ * line keeps its number while it is stored.
+ */
+unsigned long long rqshell_lines_newest(struct rqshell_lines const *);
+
+/*
+ * Call f with the number of every stored line, from the line numbered from
+ * onwards, that contains the pattern, oldest first.
+ * The stored text is scanned with memmem in one pass over the arena, so lines
+ * without a match cost next to nothing. Deferred lines are formatted to be
+ * searched.
+ */
+void rqshell_lines_search(struct rqshell_lines *, char const *pattern,
+                          int length, unsigned long long from,
+                          void (*f)(unsigned long long number, void *user),
+                          void *user);
+
+/*
+ * Number of lines currently stored.
+ */
+unsigned rqshell_lines_count(struct rqshell_lines const *);
+
+/*
+ * Bytes currently counted against the byte limit.
+ */
+size_t rqshell_lines_bytes(struct rqshell_lines const *);
+
+/*
+ * Bytes of memory held, including capacity not in use yet.
+ */
+size_t rqshell_lines_footprint(struct rqshell_lines const *);
+
+/*
+ * Change the byte limit, evicting the oldest lines if needed.
+ */
+void rqshell_lines_set_limit(struct rqshell_lines *, size_t limit);
+
+/*
+ * Forget all stored lines. The arena is kept for reuse.
+ */
+void rqshell_lines_clear(struct rqshell_lines *);
+
+#endif
@@ -0,0 +1,256 @@
+#include "rqshell_prof.h"
+#include "rqshell.h"
+#include "rqshell_clock.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PROF_CACHE (2 * PROF_SCOPES) // scope ids remembered per thread, a power of two
+#define PROF_NO_SCOPE (PROF_SCOPES) // marks a scope that could not be added
+
+// Scopes and rings shared by all threads. Scopes are only ever added, under
+// the lock, and published by bumping scope_count.
+static struct {
+  pthread_mutex_t lock;
+  pthread_once_t once;
+  pthread_key_t exit_key; // gives the thread slot back when a thread exits
+
+  char const *names[PROF_SCOPES];
+  _Atomic unsigned scope_count;
+  bool slot_used[PROF_THREADS]; // guarded by the lock
+
+  _Atomic(struct rqshell_prof_ring *) rings[PROF_THREADS][PROF_SCOPES];
+} prof = {.lock = PTHREAD_MUTEX_INITIALIZER, .once = PTHREAD_ONCE_INIT};
+
+// What a thread needs to time its scopes without touching shared state.
+static _Thread_local struct {
+  int slot; // ring slot plus one, 0 before the first scope, -1 if none was free
+  unsigned depth; // scopes open, including those past PROF_DEPTH
+  struct {
+    unsigned scope;
+    unsigned long long start;
+  } open[PROF_DEPTH];
+
+  struct {
+    char const *name;
+    unsigned scope;
+  } cache[PROF_CACHE]; // scope ids by name address
+} prof_thread;
+
+static void prof_thread_exit(void *slot) {
+  pthread_mutex_lock(&prof.lock);
+  prof.slot_used[(intptr_t)slot - 1] = false;
+  pthread_mutex_unlock(&prof.lock);
+}
+
+static void prof_init_key() {
+  pthread_key_create(&prof.exit_key, prof_thread_exit);
+}
+
+// Take a ring slot for the calling thread. Slots of threads that exited are
+// reused, their durations still count for their scopes.
+static int prof_take_slot() {
+  pthread_once(&prof.once, prof_init_key);
+
+  int slot = -1;
+  pthread_mutex_lock(&prof.lock);
+  for (int i = 0; i < PROF_THREADS; ++i) {
+    if (!prof.slot_used[i]) {
+      prof.slot_used[i] = true;
+      slot = i + 1;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&prof.lock);
+
+  if (slot > 0) {
+    pthread_setspecific(prof.exit_key, (void *)(intptr_t)slot);
+  }
+  return slot;
+}
+
+// Find or add the scope with the given name, comparing the text, so the
+// same name used in several places is one scope.
+static unsigned prof_find_scope(char const *name) {
+  pthread_mutex_lock(&prof.lock);
+  unsigned count = atomic_load_explicit(&prof.scope_count, memory_order_relaxed);
+  unsigned scope = 0;
+  while (scope < count && strcmp(prof.names[scope], name) != 0) {
+    scope++;
+  }
+  if (scope == count) {
+    if (count == PROF_SCOPES) {
+      scope = PROF_NO_SCOPE;
+    } else {
+      prof.names[count] = name;
+      atomic_store_explicit(&prof.scope_count, count + 1, memory_order_release);
+    }
+  }
+  pthread_mutex_unlock(&prof.lock);
+  return scope;
+}
+
+void rqshell_prof_begin(char const *name) {
+  unsigned depth = prof_thread.depth++;
+  if (depth >= PROF_DEPTH) {
+    return;
+  }
+
+  // open addressing, so names that hash alike do not evict each other and
+  // only the first use of a name on a thread takes the lock
+  unsigned hash = (unsigned)((uintptr_t)name >> 3) * 2654435761u;
+  unsigned scope = PROF_NO_SCOPE;
+  bool cached = false;
+  for (unsigned probe = 0; probe < PROF_CACHE; ++probe) {
+    unsigned i = (hash + probe) & (PROF_CACHE - 1);
+    if (prof_thread.cache[i].name == name) {
+      scope = prof_thread.cache[i].scope;
+      cached = true;
+      break;
+    } else if (!prof_thread.cache[i].name) {
+      scope = prof_find_scope(name);
+      prof_thread.cache[i].name = name;
+      prof_thread.cache[i].scope = scope;
+      cached = true;
+      break;
+    }
+  }
+  if (!cached) {
+    // more name addresses than the cache holds, look the name up every time
+    scope = prof_find_scope(name);
+  }
+
+  prof_thread.open[depth].scope = scope;
+  prof_thread.open[depth].start = rqshell_now_ns();
+}
+
+void rqshell_prof_end(void) {
+  unsigned long long end = rqshell_now_ns();
+  if (prof_thread.depth == 0) {
+    return; // no scope is open
+  }
+  unsigned depth = --prof_thread.depth;
+  if (depth >= PROF_DEPTH) {
+    return;
+  }
+  unsigned scope = prof_thread.open[depth].scope;
+  if (scope == PROF_NO_SCOPE) {
+    return;
+  }
+
+  if (prof_thread.slot == 0) {
+    prof_thread.slot = prof_take_slot();
+  }
+  if (prof_thread.slot < 0) {
+    return;
+  }
+
+  _Atomic(struct rqshell_prof_ring *) *at =
+      &prof.rings[prof_thread.slot - 1][scope];
+  struct rqshell_prof_ring *ring =
+      atomic_load_explicit(at, memory_order_acquire);
+  if (!ring) {
+    ring = calloc(1, sizeof(*ring));
+    if (!ring) {
+      return;
+    }
+    atomic_store_explicit(at, ring, memory_order_release);
+  }
+
+  unsigned long long ns = end - prof_thread.open[depth].start;
+  unsigned long long n =
+      atomic_load_explicit(&ring->count, memory_order_relaxed);
+  atomic_store_explicit(&ring->samples[n & (PROF_SAMPLES - 1)],
+                        ns > UINT32_MAX ? UINT32_MAX : (uint32_t)ns,
+                        memory_order_relaxed);
+  atomic_store_explicit(&ring->count, n + 1, memory_order_release);
+}
+
+size_t rqshell_prof_footprint(void) {
+  size_t bytes = 0;
+  for (int slot = 0; slot < PROF_THREADS; ++slot) {
+    for (unsigned scope = 0; scope < PROF_SCOPES; ++scope) {
+      if (atomic_load_explicit(&prof.rings[slot][scope],
+                               memory_order_relaxed)) {
+        bytes += sizeof(struct rqshell_prof_ring);
+      }
+    }
+  }
+  return bytes;
+}
+
+static int prof_compare(void const *a, void const *b) {
+  uint32_t x = *(uint32_t const *)a, y = *(uint32_t const *)b;
+  return (x > y) - (x < y);
+}
+
+void rqshell_prof_foreach(void (*f)(char const *name,
+                                    struct rqshell_prof_stats const *stats,
+                                    void *user),
+                          void *user) {
+  uint32_t *samples = malloc(PROF_THREADS * PROF_SAMPLES * sizeof(*samples));
+  if (!samples) {
+    return;
+  }
+
+  unsigned scopes =
+      atomic_load_explicit(&prof.scope_count, memory_order_acquire);
+  for (unsigned scope = 0; scope < scopes; ++scope) {
+    struct rqshell_prof_stats stats = {0};
+    unsigned n = 0;
+
+    for (int slot = 0; slot < PROF_THREADS; ++slot) {
+      struct rqshell_prof_ring *ring = atomic_load_explicit(
+          &prof.rings[slot][scope], memory_order_acquire);
+      if (!ring) {
+        continue;
+      }
+      unsigned long long count =
+          atomic_load_explicit(&ring->count, memory_order_acquire);
+      unsigned long long from =
+          atomic_load_explicit(&ring->cleared, memory_order_relaxed);
+      stats.calls += count - from;
+      if (count - from > PROF_SAMPLES) {
+        from = count - PROF_SAMPLES;
+      }
+      for (unsigned long long i = from; i < count; ++i) {
+        samples[n++] = atomic_load_explicit(
+            &ring->samples[i & (PROF_SAMPLES - 1)], memory_order_relaxed);
+      }
+    }
+    if (n == 0) {
+      continue;
+    }
+
+    qsort(samples, n, sizeof(*samples), prof_compare);
+    double total = 0.0;
+    for (unsigned i = 0; i < n; ++i) {
+      total += samples[i];
+    }
+    stats.samples = n;
+    stats.min_us = samples[0] / 1000.0;
+    stats.avg_us = total / n / 1000.0;
+    stats.p99_us = samples[(n * 99 + 99) / 100 - 1] / 1000.0; // nearest rank
+    stats.max_us = samples[n - 1] / 1000.0;
+    f(prof.names[scope], &stats, user);
+  }
+
+  free(samples);
+}
+
+void rqshell_prof_reset(void) {
+  unsigned scopes =
+      atomic_load_explicit(&prof.scope_count, memory_order_acquire);
+  for (int slot = 0; slot < PROF_THREADS; ++slot) {
+    for (unsigned scope = 0; scope < scopes; ++scope) {
+      struct rqshell_prof_ring *ring = atomic_load_explicit(
+          &prof.rings[slot][scope], memory_order_acquire);
+      if (ring) {
+        atomic_store_explicit(
+            &ring->cleared,
+            atomic_load_explicit(&ring->count, memory_order_acquire),
+            memory_order_relaxed);
+      }
+    }
+  }
+}
@@ -0,0 +1,27 @@
+#ifndef _HEADER_FILE_rqshell_prof_20261017121655_
+#define _HEADER_FILE_rqshell_prof_20261017121655_
+
+#include "rqshell_config.h"
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * The newest durations of one scope on one thread.
+ * Only the owning thread writes to the ring, storing a duration and then
+ * publishing it by bumping count, so readers on other threads need no lock.
+ * A reader may see a slot overwritten while it reads, which only changes
+ * which recent durations the statistics are taken over.
+ */
+struct rqshell_prof_ring {
+  _Atomic unsigned long long count; // durations ever written
+  _Atomic unsigned long long cleared; // count at the last reset
+  _Atomic uint32_t samples[PROF_SAMPLES]; // nanoseconds, by count modulo size
+};
+
+/*
+ * Bytes of memory held by the rings of all threads.
+ */
+size_t rqshell_prof_footprint(void);
+
+#endif
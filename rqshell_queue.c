@@ -0,0 +1,114 @@
+#include "rqshell_queue.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define QUEUE_MASK (POST_QUEUE_SIZE - 1)
+
+_Static_assert((POST_QUEUE_SIZE & QUEUE_MASK) == 0,
+               "POST_QUEUE_SIZE must be a power of two");
+
+// Claim the slot at the head of the queue, or return a null pointer if full.
+static struct rqshell_queue_slot *queue_claim(struct rqshell_queue *q,
+                                              size_t *position,
+                                              bool count_drop) {
+  size_t pos = atomic_load_explicit(&q->head, memory_order_relaxed);
+
+  for (;;) {
+    struct rqshell_queue_slot *slot = q->slots + (pos & QUEUE_MASK);
+    size_t seq = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+    intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+
+    if (diff == 0) {
+      if (atomic_compare_exchange_weak_explicit(&q->head, &pos, pos + 1,
+                                                memory_order_relaxed,
+                                                memory_order_relaxed)) {
+        *position = pos;
+        return slot;
+      }
+    } else if (diff < 0) {
+      if (count_drop) {
+        atomic_fetch_add_explicit(&q->dropped, 1, memory_order_relaxed);
+      }
+      return NULL;
+    } else {
+      pos = atomic_load_explicit(&q->head, memory_order_relaxed);
+    }
+  }
+}
+
+// Hand a filled slot over to the consumer.
+static inline void queue_publish(struct rqshell_queue_slot *slot,
+                                 size_t position) {
+  atomic_store_explicit(&slot->sequence, position + 1, memory_order_release);
+}
+
+void rqshell_queue_init(struct rqshell_queue *q) {
+  for (size_t i = 0; i < POST_QUEUE_SIZE; ++i) {
+    atomic_init(&q->slots[i].sequence, i);
+  }
+  atomic_init(&q->head, 0);
+  atomic_init(&q->dropped, 0);
+  q->tail = 0;
+}
+
+static bool queue_push(struct rqshell_queue *q, char const *text, int len,
+                       bool count_drop) {
+  size_t pos;
+  struct rqshell_queue_slot *slot = queue_claim(q, &pos, count_drop);
+  if (!slot) {
+    return false;
+  }
+
+  if (len > LINE_SIZE - 1) {
+    len = LINE_SIZE - 1;
+  }
+  memcpy(slot->text, text, len);
+  slot->text[len] = '\0';
+  slot->length = len;
+
+  queue_publish(slot, pos);
+  return true;
+}
+
+bool rqshell_queue_push(struct rqshell_queue *q, char const *text, int len) {
+  return queue_push(q, text, len, true);
+}
+
+bool rqshell_queue_try_push(struct rqshell_queue *q, char const *text,
+                            int len) {
+  return queue_push(q, text, len, false);
+}
+
+bool rqshell_queue_vpushf(struct rqshell_queue *q, char const *format,
+                          va_list args) {
+  size_t pos;
+  struct rqshell_queue_slot *slot = queue_claim(q, &pos, true);
+  if (!slot) {
+    return false;
+  }
+
+  int written = vsnprintf(slot->text, LINE_SIZE, format, args);
+  if (written < 0) {
+    slot->text[0] = '\0';
+    written = 0;
+  }
+  slot->length = written < LINE_SIZE ? written : LINE_SIZE - 1;
+
+  // the slot is claimed, so it has to be published even if formatting failed
+  queue_publish(slot, pos);
+  return true;
+}
+
+struct rqshell_queue_slot *rqshell_queue_peek(struct rqshell_queue *q) {
+  struct rqshell_queue_slot *slot = q->slots + (q->tail & QUEUE_MASK);
+  size_t seq = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+  return seq == q->tail + 1 ? slot : NULL;
+}
+
+void rqshell_queue_pop(struct rqshell_queue *q) {
+  struct rqshell_queue_slot *slot = q->slots + (q->tail & QUEUE_MASK);
+  atomic_store_explicit(&slot->sequence, q->tail + POST_QUEUE_SIZE,
+                        memory_order_release);
+  q->tail++;
+}
@@ -0,0 +1,73 @@
+#ifndef _HEADER_FILE_rqshell_queue_20261016140322_
+#define _HEADER_FILE_rqshell_queue_20261016140322_
+
+#include "rqshell_config.h"
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * A queued line of text.
+ */
+struct rqshell_queue_slot {
+  atomic_size_t sequence; // tells whose turn it is to use the slot
+  int length;
+  char text[LINE_SIZE];
+};
+
+/*
+ * Console line queue.
+ * A bounded lock-free queue that any number of threads can push lines into,
+ * while a single thread pops them. Pushing never blocks: when the queue is
+ * full the line is dropped and counted instead.
+ *
+ * Based on Dmitry Vyukov's bounded MPMC queue, with the consumer side
+ * simplified to a single thread.
+ */
+struct rqshell_queue {
+  struct rqshell_queue_slot slots[POST_QUEUE_SIZE];
+  atomic_size_t head; // next position a producer claims
+  size_t tail; // next position the consumer reads, only touched by the consumer
+  atomic_size_t dropped; // lines dropped because the queue was full
+};
+
+/*
+ * Reset the queue to empty. Must not race with any push or pop.
+ */
+void rqshell_queue_init(struct rqshell_queue *);
+
+/*
+ * Push a line of at most LINE_SIZE - 1 characters. Safe to call from any thread.
+ *
+ * Returns false if the queue was full and the line was dropped.
+ */
+bool rqshell_queue_push(struct rqshell_queue *, char const *text, int len);
+
+/*
+ * Same as rqshell_queue_push, but a line that does not fit is not counted as
+ * dropped, for producers that wait for room and try again.
+ */
+bool rqshell_queue_try_push(struct rqshell_queue *, char const *text, int len);
+
+/*
+ * Push a formatted line, formatting straight into the queue.
+ * Safe to call from any thread.
+ *
+ * Returns false if the queue was full and the line was dropped.
+ */
+bool rqshell_queue_vpushf(struct rqshell_queue *, char const *format, va_list args);
+
+/*
+ * Get the oldest queued line without removing it, or a null pointer if the
+ * queue is empty. Only the consumer thread may call this.
+ */
+struct rqshell_queue_slot *rqshell_queue_peek(struct rqshell_queue *);
+
+/*
+ * Remove the line returned by the last rqshell_queue_peek.
+ * Only the consumer thread may call this.
+ */
+void rqshell_queue_pop(struct rqshell_queue *);
+
+#endif
@@ -0,0 +1,158 @@
+#include "rqshell_trie.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define TRIE_MIN_CAPACITY (256)
+
+// Append a node, returning its number, or 0 if memory ran out.
+static uint32_t trie_new_node(struct rqshell_trie *trie, unsigned char byte) {
+  if (trie->used == trie->cap) {
+    uint32_t cap = trie->cap ? trie->cap * 2 : TRIE_MIN_CAPACITY;
+    struct rqshell_trie_node *nodes =
+        realloc(trie->nodes, cap * sizeof(*nodes));
+    if (!nodes) {
+      return 0;
+    }
+    trie->nodes = nodes;
+    trie->cap = cap;
+  }
+
+  trie->nodes[trie->used] = (struct rqshell_trie_node){.byte = byte};
+  return trie->used++;
+}
+
+// Find the child of node for byte, or 0 if there is none.
+static uint32_t trie_child(struct rqshell_trie const *trie, uint32_t node,
+                           unsigned char byte) {
+  uint32_t child = trie->nodes[node].first_child;
+  while (child && trie->nodes[child].byte < byte) {
+    child = trie->nodes[child].next_sibling;
+  }
+  return child && trie->nodes[child].byte == byte ? child : 0;
+}
+
+// Find or add the child of node for byte, keeping the siblings ordered.
+static uint32_t trie_add_child(struct rqshell_trie *trie, uint32_t node,
+                               unsigned char byte) {
+  uint32_t *link = &trie->nodes[node].first_child;
+  while (*link && trie->nodes[*link].byte < byte) {
+    link = &trie->nodes[*link].next_sibling;
+  }
+  if (*link && trie->nodes[*link].byte == byte) {
+    return *link;
+  }
+
+  // the link points into the nodes, which may move while growing
+  size_t at = (char *)link - (char *)trie->nodes;
+  uint32_t child = trie_new_node(trie, byte);
+  if (!child) {
+    return 0;
+  }
+  link = (uint32_t *)((char *)trie->nodes + at);
+  trie->nodes[child].next_sibling = *link;
+  *link = child;
+  return child;
+}
+
+bool rqshell_trie_insert(struct rqshell_trie *trie, char const *name) {
+  if (trie->used == 0) {
+    trie_new_node(trie, 0); // the root, numbered 0 like a failure
+    if (trie->used == 0) {
+      return false;
+    }
+  }
+
+  int len = (int)strlen(name);
+  long found = rqshell_trie_find(trie, name, len);
+  if (found >= 0 && trie->nodes[found].name) {
+    return true; // already added
+  }
+
+  uint32_t node = 0;
+  for (int i = 0; i < len; ++i) {
+    node = trie_add_child(trie, node, (unsigned char)name[i]);
+    if (!node) {
+      return false;
+    }
+  }
+  trie->nodes[node].name = name;
+
+  // only count the name once it is in, so running out of memory above
+  // leaves the counts right
+  node = 0;
+  trie->nodes[0].count++;
+  for (int i = 0; i < len; ++i) {
+    node = trie_child(trie, node, (unsigned char)name[i]);
+    trie->nodes[node].count++;
+  }
+  return true;
+}
+
+long rqshell_trie_find(struct rqshell_trie const *trie, char const *prefix,
+                       int len) {
+  if (trie->used == 0) {
+    return -1;
+  }
+
+  uint32_t node = 0;
+  for (int i = 0; i < len; ++i) {
+    node = trie_child(trie, node, (unsigned char)prefix[i]);
+    if (!node) {
+      return -1;
+    }
+  }
+  return trie->nodes[node].count ? (long)node : -1;
+}
+
+uint32_t rqshell_trie_count(struct rqshell_trie const *trie, long node) {
+  return node >= 0 ? trie->nodes[node].count : 0;
+}
+
+int rqshell_trie_common(struct rqshell_trie const *trie, long node, char *out,
+                        int cap) {
+  int length = 0;
+  if (node >= 0) {
+    // follow the path while it does not branch and no name ends on it
+    struct rqshell_trie_node const *at = trie->nodes + node;
+    while (length + 1 < cap && !at->name && at->first_child &&
+           !trie->nodes[at->first_child].next_sibling) {
+      at = trie->nodes + at->first_child;
+      out[length++] = (char)at->byte;
+    }
+  }
+  if (cap > 0) {
+    out[length] = '\0';
+  }
+  return length;
+}
+
+static void trie_visit(struct rqshell_trie const *trie, uint32_t node,
+                       void (*f)(char const *name, void *user), void *user,
+                       uint32_t *left) {
+  struct rqshell_trie_node const *at = trie->nodes + node;
+  if (at->name && *left > 0) {
+    f(at->name, user);
+    --*left;
+  }
+  for (uint32_t child = at->first_child; child && *left > 0;
+       child = trie->nodes[child].next_sibling) {
+    trie_visit(trie, child, f, user, left);
+  }
+}
+
+void rqshell_trie_foreach(struct rqshell_trie const *trie, long node,
+                          void (*f)(char const *name, void *user), void *user,
+                          uint32_t limit) {
+  if (node >= 0) {
+    trie_visit(trie, (uint32_t)node, f, user, &limit);
+  }
+}
+
+void rqshell_trie_free(struct rqshell_trie *trie) {
+  free(trie->nodes);
+  *trie = (struct rqshell_trie){0};
+}
+
+size_t rqshell_trie_footprint(struct rqshell_trie const *trie) {
+  return trie->cap * sizeof(*trie->nodes);
+}
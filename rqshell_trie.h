@@ -0,0 +1,79 @@
+#ifndef _HEADER_FILE_rqshell_trie_20261017091204_
+#define _HEADER_FILE_rqshell_trie_20261017091204_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * A node of a rqshell_trie, standing for the bytes on the path to it.
+ */
+struct rqshell_trie_node {
+  uint32_t first_child; // 0 when the node has no children
+  uint32_t next_sibling; // 0 for the last child, siblings ordered by byte
+  uint32_t count; // names ending at or below this node
+  char const *name; // the name ending at this node, or null
+  unsigned char byte;
+};
+
+/*
+ * Prefix tree of names.
+ * Finding the names that start with a prefix costs the length of the prefix,
+ * no matter how many names there are, and every node knows how many names
+ * lie below it, so counting the matches costs nothing more.
+ * Node 0 is the root, standing for the empty prefix.
+ */
+struct rqshell_trie {
+  struct rqshell_trie_node *nodes;
+  uint32_t used;
+  uint32_t cap;
+};
+
+/*
+ * Add a name. The name is not copied and must outlive the trie.
+ *
+ * Returns false if memory ran out.
+ */
+bool rqshell_trie_insert(struct rqshell_trie *, char const *name);
+
+/*
+ * Find the node standing for the first len bytes of prefix.
+ *
+ * Returns the node number, or -1 if no name starts with the prefix.
+ */
+long rqshell_trie_find(struct rqshell_trie const *, char const *prefix,
+                       int len);
+
+/*
+ * Get the number of names starting with the prefix of a node.
+ */
+uint32_t rqshell_trie_count(struct rqshell_trie const *, long node);
+
+/*
+ * Write the bytes that follow the prefix of a node in every name below it,
+ * writing at most cap bytes, and null terminate them.
+ *
+ * Returns the number of bytes written, not counting the null byte.
+ */
+int rqshell_trie_common(struct rqshell_trie const *, long node, char *out,
+                        int cap);
+
+/*
+ * Call f with the names below a node in byte order, stopping after limit
+ * names.
+ */
+void rqshell_trie_foreach(struct rqshell_trie const *, long node,
+                          void (*f)(char const *name, void *user), void *user,
+                          uint32_t limit);
+
+/*
+ * Release the memory held by the trie. A zero initialized trie is empty.
+ */
+void rqshell_trie_free(struct rqshell_trie *);
+
+/*
+ * Bytes of memory held by the trie, including capacity not in use yet.
+ */
+size_t rqshell_trie_footprint(struct rqshell_trie const *);
+
+#endif
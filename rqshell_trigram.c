@@ -0,0 +1,307 @@
+#define _GNU_SOURCE // memmem
+#include "rqshell_trigram.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TRIGRAM_MIN_SLOTS (1024)
+#define TRIGRAM_MIN_IDS (4)
+
+static inline uint32_t trigram_key(char const *t) {
+  return ((uint32_t)(unsigned char)t[0] << 16 |
+          (uint32_t)(unsigned char)t[1] << 8 | (uint32_t)(unsigned char)t[2]) +
+         1;
+}
+
+static inline uint32_t trigram_slot(uint32_t key, uint32_t mask) {
+  return (key * 2654435761u) & mask; // Knuth's multiplicative hash
+}
+
+static struct rqshell_trigram_postings *
+trigram_find(struct rqshell_trigram_index const *index, uint32_t key) {
+  if (index->slots_cap == 0) {
+    return NULL;
+  }
+  uint32_t mask = index->slots_cap - 1;
+  for (uint32_t i = trigram_slot(key, mask);; i = (i + 1) & mask) {
+    struct rqshell_trigram_postings *slot = index->slots + i;
+    if (slot->key == key) {
+      return slot;
+    } else if (slot->key == 0) {
+      return NULL;
+    }
+  }
+}
+
+static bool trigram_grow(struct rqshell_trigram_index *index) {
+  uint32_t cap = index->slots_cap ? index->slots_cap * 2 : TRIGRAM_MIN_SLOTS;
+  struct rqshell_trigram_postings *slots = calloc(cap, sizeof(*slots));
+  if (!slots) {
+    return false;
+  }
+
+  for (uint32_t i = 0; i < index->slots_cap; ++i) {
+    struct rqshell_trigram_postings *old = index->slots + i;
+    if (old->key) {
+      uint32_t s = trigram_slot(old->key, cap - 1);
+      while (slots[s].key) {
+        s = (s + 1) & (cap - 1);
+      }
+      slots[s] = *old;
+    }
+  }
+
+  free(index->slots);
+  index->slots = slots;
+  index->slots_cap = cap;
+  return true;
+}
+
+static struct rqshell_trigram_postings *
+trigram_insert(struct rqshell_trigram_index *index, uint32_t key) {
+  if ((index->slots_used + 1) * 2 > index->slots_cap && !trigram_grow(index)) {
+    return NULL;
+  }
+
+  uint32_t mask = index->slots_cap - 1;
+  uint32_t i = trigram_slot(key, mask);
+  while (index->slots[i].key && index->slots[i].key != key) {
+    i = (i + 1) & mask;
+  }
+  if (!index->slots[i].key) {
+    index->slots[i].key = key;
+    index->slots_used++;
+  }
+  return index->slots + i;
+}
+
+static void trigram_post(struct rqshell_trigram_postings *postings,
+                         uint32_t id) {
+  // an entry containing the trigram more than once is listed once
+  if (postings->count > 0 && postings->ids[postings->count - 1] == id) {
+    return;
+  }
+  if (postings->count == postings->cap) {
+    uint32_t cap = postings->cap ? postings->cap * 2 : TRIGRAM_MIN_IDS;
+    uint32_t *ids = realloc(postings->ids, cap * sizeof(*ids));
+    if (!ids) {
+      return;
+    }
+    postings->ids = ids;
+    postings->cap = cap;
+  }
+  postings->ids[postings->count++] = id;
+}
+
+void rqshell_trigram_free(struct rqshell_trigram_index *index) {
+  for (uint32_t i = 0; i < index->slots_cap; ++i) {
+    free(index->slots[i].ids);
+  }
+  free(index->slots);
+  free(index->entries);
+  free(index->text);
+  *index = (struct rqshell_trigram_index){0};
+}
+
+size_t rqshell_trigram_footprint(struct rqshell_trigram_index const *index) {
+  size_t bytes = index->text_cap +
+                 index->entries_cap * sizeof(*index->entries) +
+                 index->slots_cap * sizeof(*index->slots);
+  for (uint32_t i = 0; i < index->slots_cap; ++i) {
+    bytes += index->slots[i].cap * sizeof(*index->slots[i].ids);
+  }
+  return bytes;
+}
+
+uint32_t rqshell_trigram_add(struct rqshell_trigram_index *index,
+                             char const *text, size_t length) {
+  if (index->count == index->entries_cap) {
+    uint32_t cap = index->entries_cap ? index->entries_cap * 2 : 256;
+    void *entries = realloc(index->entries, cap * sizeof(*index->entries));
+    if (!entries) {
+      return index->count;
+    }
+    index->entries = entries;
+    index->entries_cap = cap;
+  }
+
+  if (index->text_used + length > index->text_cap) {
+    size_t cap = index->text_cap ? index->text_cap * 2 : 4096;
+    while (cap < index->text_used + length) {
+      cap *= 2;
+    }
+    char *text_grown = realloc(index->text, cap);
+    if (!text_grown) {
+      return index->count;
+    }
+    index->text = text_grown;
+    index->text_cap = cap;
+  }
+
+  uint32_t id = index->count++;
+  memcpy(index->text + index->text_used, text, length);
+  index->entries[id].offset = index->text_used;
+  index->entries[id].length = length;
+  index->text_used += length;
+
+  for (size_t i = 0; i + 3 <= length; ++i) {
+    struct rqshell_trigram_postings *postings =
+        trigram_insert(index, trigram_key(text + i));
+    if (postings) {
+      trigram_post(postings, id);
+    }
+  }
+  return id;
+}
+
+char const *rqshell_trigram_text(struct rqshell_trigram_index const *index,
+                                 uint32_t id, size_t *length) {
+  *length = index->entries[id].length;
+  return index->text + index->entries[id].offset;
+}
+
+void rqshell_trigram_search_free(struct rqshell_trigram_search *search) {
+  free(search->candidates);
+  *search = (struct rqshell_trigram_search){0};
+}
+
+static bool trigram_reserve(struct rqshell_trigram_search *search,
+                            size_t more) {
+  if (search->used + more <= search->cap) {
+    return true;
+  }
+  size_t cap = search->cap ? search->cap * 2 : 1024;
+  while (cap < search->used + more) {
+    cap *= 2;
+  }
+  uint32_t *candidates = realloc(search->candidates, cap * sizeof(uint32_t));
+  if (!candidates) {
+    return false;
+  }
+  search->candidates = candidates;
+  search->cap = cap;
+  return true;
+}
+
+// Add the candidate set for query length n, narrowing the set for n - 1 to
+// the entries that also contain the trigram ending at n.
+static void trigram_narrow(struct rqshell_trigram_search *search,
+                           struct rqshell_trigram_index const *index, int n) {
+  search->start[n] = search->used;
+
+  struct rqshell_trigram_postings const *postings =
+      trigram_find(index, trigram_key(search->query + n - 3));
+  if (!postings) {
+    return;
+  }
+
+  if (n == 3) {
+    if (trigram_reserve(search, postings->count)) {
+      memcpy(search->candidates + search->used, postings->ids,
+             postings->count * sizeof(uint32_t));
+      search->used += postings->count;
+    }
+    return;
+  }
+
+  // both sets are sorted, so a merge finds the entries in both
+  size_t previous = search->start[n - 1];
+  size_t previous_count = search->start[n] - previous;
+  if (!trigram_reserve(search, previous_count)) {
+    return;
+  }
+
+  uint32_t const *a = search->candidates + previous;
+  uint32_t const *b = postings->ids;
+  size_t i = 0, j = 0;
+  while (i < previous_count && j < postings->count) {
+    if (a[i] < b[j]) {
+      i++;
+    } else if (a[i] > b[j]) {
+      j++;
+    } else {
+      search->candidates[search->used++] = a[i];
+      i++;
+      j++;
+    }
+  }
+}
+
+void rqshell_trigram_search_set(struct rqshell_trigram_search *search,
+                                struct rqshell_trigram_index const *index,
+                                char const *query, int length) {
+  if (length > LINE_SIZE - 1) {
+    length = LINE_SIZE - 1;
+  }
+
+  int common = 0;
+  while (common < length && common < search->length &&
+         query[common] == search->query[common]) {
+    common++;
+  }
+
+  // drop the sets of the characters that changed
+  if (common < search->length) {
+    search->used = common >= 3 ? search->start[common + 1] : 0;
+  }
+
+  memcpy(search->query + common, query + common, length - common);
+  search->query[length] = '\0';
+  search->length = length;
+
+  for (int n = common + 1; n <= length; ++n) {
+    if (n >= 3) {
+      trigram_narrow(search, index, n);
+    }
+  }
+}
+
+static bool trigram_matches(struct rqshell_trigram_search const *search,
+                            struct rqshell_trigram_index const *index,
+                            uint32_t id) {
+  size_t length;
+  char const *text = rqshell_trigram_text(index, id, &length);
+  return memmem(text, length, search->query, search->length) != NULL;
+}
+
+long rqshell_trigram_search_next(struct rqshell_trigram_search *search,
+                                 struct rqshell_trigram_index const *index,
+                                 long before) {
+  if (search->length == 0) {
+    return -1;
+  }
+  if (before > (long)index->count) {
+    before = index->count;
+  }
+
+  if (search->length < 3) {
+    // too short for the index, but short queries match often and the
+    // newest entries are tried first
+    for (long id = before - 1; id >= 0; --id) {
+      if (trigram_matches(search, index, (uint32_t)id)) {
+        return id;
+      }
+    }
+    return -1;
+  }
+
+  // the candidates contain every trigram of the query, but not necessarily
+  // in the right order, so each is checked before it is returned
+  uint32_t const *set = search->candidates + search->start[search->length];
+  size_t lo = 0, hi = search->used - search->start[search->length];
+  while (lo < hi) {
+    size_t mid = (lo + hi) / 2;
+    if ((long)set[mid] < before) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+
+  for (size_t i = lo; i-- > 0;) {
+    if (trigram_matches(search, index, set[i])) {
+      return set[i];
+    }
+  }
+  return -1;
+}
@@ -0,0 +1,105 @@
+#ifndef _HEADER_FILE_rqshell_trigram_20261016224015_
+#define _HEADER_FILE_rqshell_trigram_20261016224015_
+
+#include "rqshell_config.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Entries that contain one trigram, in the order they were added.
+ */
+struct rqshell_trigram_postings {
+  uint32_t key; // the three bytes, plus one so that 0 marks an empty slot
+  uint32_t count;
+  uint32_t cap;
+  uint32_t *ids;
+};
+
+/*
+ * Substring search index.
+ * Keeps a copy of every entry added and, for every three byte sequence,
+ * the list of entries that contain it. Entries are numbered from 0 in the
+ * order they are added.
+ */
+struct rqshell_trigram_index {
+  char *text; // the entries back to back
+  size_t text_used;
+  size_t text_cap;
+
+  struct {
+    size_t offset;
+    size_t length;
+  } *entries;
+  uint32_t count;
+  uint32_t entries_cap;
+
+  struct rqshell_trigram_postings *slots; // open addressing by trigram
+  uint32_t slots_used;
+  uint32_t slots_cap; // always zero or a power of two
+};
+
+/*
+ * An incremental search for entries containing a query.
+ * Candidates for each query length are kept, so growing the query by a
+ * character only narrows the previous candidates, and shrinking it only
+ * drops the newest candidate sets.
+ */
+struct rqshell_trigram_search {
+  char query[LINE_SIZE];
+  int length;
+
+  // candidate ids for each query length of at least three, stored one
+  // set after the other, the set for length n starts at start[n]
+  uint32_t *candidates;
+  size_t used;
+  size_t cap;
+  size_t start[LINE_SIZE + 1];
+};
+
+/*
+ * Release the memory held by the index. A zero initialized index is empty.
+ */
+void rqshell_trigram_free(struct rqshell_trigram_index *);
+
+/*
+ * Bytes of memory held by the index, including capacity not in use yet.
+ * Costs a pass over the trigram slots.
+ */
+size_t rqshell_trigram_footprint(struct rqshell_trigram_index const *);
+
+/*
+ * Add an entry, returning its number.
+ */
+uint32_t rqshell_trigram_add(struct rqshell_trigram_index *, char const *text,
+                             size_t length);
+
+/*
+ * Get the text of an entry, which is not null terminated.
+ */
+char const *rqshell_trigram_text(struct rqshell_trigram_index const *,
+                                 uint32_t id, size_t *length);
+
+/*
+ * Release the memory held by the search. A zero initialized search is empty.
+ */
+void rqshell_trigram_search_free(struct rqshell_trigram_search *);
+
+/*
+ * Change the query of the search.
+ * Costs the size of the candidate sets of the characters that changed.
+ */
+void rqshell_trigram_search_set(struct rqshell_trigram_search *,
+                                struct rqshell_trigram_index const *,
+                                char const *query, int length);
+
+/*
+ * Find the newest entry containing the query that is older than the entry
+ * numbered before. Pass the entry count to find the newest match.
+ *
+ * Returns the entry number, or -1 if no older entry matches.
+ */
+long rqshell_trigram_search_next(struct rqshell_trigram_search *,
+                                 struct rqshell_trigram_index const *,
+                                 long before);
+
+#endif
@@ -0,0 +1,249 @@
+#include "rqshell_walk.h"
+#include "rqshell_config.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define WALK_PATH_SIZE (4096)
+#define WALK_MIN_STACK (64)
+
+// Directories a thread still has to read. The owner pushes and pops at the
+// top, thieves take from the bottom, where the directories closest to the
+// root, and so usually the biggest subtrees, are.
+struct walk_stack {
+  pthread_mutex_t lock;
+  char **dirs;
+  int bottom; // oldest directory not stolen yet
+  int top; // one past the newest directory
+  int cap;
+};
+
+struct walk_shared {
+  struct rqshell_walk const *walk;
+  struct walk_stack stacks[WALK_THREADS];
+  int threads;
+  atomic_long pending; // directories pushed but not read to the end yet
+  atomic_bool stop;
+};
+
+struct walk_thread {
+  struct walk_shared *shared;
+  int index;
+};
+
+static bool walk_push(struct walk_stack *stack, char *dir) {
+  bool pushed = true;
+
+  pthread_mutex_lock(&stack->lock);
+  if (stack->top == stack->cap && stack->bottom > 0) {
+    memmove(stack->dirs, stack->dirs + stack->bottom,
+            (stack->top - stack->bottom) * sizeof(char *));
+    stack->top -= stack->bottom;
+    stack->bottom = 0;
+  } else if (stack->top == stack->cap) {
+    int cap = stack->cap ? stack->cap * 2 : WALK_MIN_STACK;
+    char **dirs = realloc(stack->dirs, cap * sizeof(char *));
+    if (dirs) {
+      stack->dirs = dirs;
+      stack->cap = cap;
+    } else {
+      pushed = false;
+    }
+  }
+  if (pushed) {
+    stack->dirs[stack->top++] = dir;
+  }
+  pthread_mutex_unlock(&stack->lock);
+
+  return pushed;
+}
+
+// Take the newest directory when own is true, otherwise the oldest.
+static char *walk_take(struct walk_stack *stack, bool own) {
+  char *dir = NULL;
+
+  pthread_mutex_lock(&stack->lock);
+  if (stack->top > stack->bottom) {
+    dir = own ? stack->dirs[--stack->top] : stack->dirs[stack->bottom++];
+  }
+  if (stack->top == stack->bottom) {
+    stack->top = stack->bottom = 0;
+  }
+  pthread_mutex_unlock(&stack->lock);
+
+  return dir;
+}
+
+// Visit the entries of dir and push its subdirectories onto own.
+static void walk_read(struct walk_shared *shared, struct walk_stack *own,
+                      char const *dir) {
+  struct rqshell_walk const *walk = shared->walk;
+  DIR *d = opendir(dir);
+  if (!d) {
+    return;
+  }
+
+  char path[WALK_PATH_SIZE];
+  size_t dir_len = strlen(dir);
+  bool slash = dir_len > 0 && dir[dir_len - 1] == '/';
+  if (dir_len + 2 > WALK_PATH_SIZE) {
+    closedir(d);
+    return;
+  }
+  memcpy(path, dir, dir_len);
+  if (!slash) {
+    path[dir_len++] = '/';
+  }
+
+  struct dirent *e;
+  while (!atomic_load_explicit(&shared->stop, memory_order_relaxed) &&
+         (e = readdir(d))) {
+    char const *name = e->d_name;
+    if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0) {
+      continue;
+    }
+
+    size_t name_len = strlen(name);
+    if (dir_len + name_len + 1 > WALK_PATH_SIZE) {
+      continue;
+    }
+    memcpy(path + dir_len, name, name_len + 1);
+
+    struct rqshell_walk_entry entry = {.path = path, .name = path + dir_len};
+
+    // the entry type usually comes with the directory entry, which saves
+    // a stat call per entry when sizes are not needed
+    bool need_stat = walk->stat;
+#ifdef DT_DIR
+    if (e->d_type == DT_UNKNOWN) {
+      need_stat = true;
+    } else {
+      entry.is_dir = e->d_type == DT_DIR;
+      entry.is_file = e->d_type == DT_REG;
+    }
+#else
+    need_stat = true;
+#endif
+
+    if (need_stat) {
+      struct stat st;
+      if (fstatat(dirfd(d), name, &st, AT_SYMLINK_NOFOLLOW) != 0) {
+        continue;
+      }
+      entry.is_dir = S_ISDIR(st.st_mode);
+      entry.is_file = S_ISREG(st.st_mode);
+      entry.size = S_ISREG(st.st_mode) ? (unsigned long long)st.st_size : 0;
+    }
+
+    if (!walk->visit(&entry, walk->user)) {
+      atomic_store_explicit(&shared->stop, true, memory_order_relaxed);
+      break;
+    }
+
+    if (entry.is_dir) {
+      char *subdir = strdup(path);
+      atomic_fetch_add_explicit(&shared->pending, 1, memory_order_relaxed);
+      if (!subdir || !walk_push(own, subdir)) {
+        free(subdir);
+        atomic_fetch_sub_explicit(&shared->pending, 1, memory_order_relaxed);
+      }
+    }
+  }
+
+  closedir(d);
+}
+
+static void *walk_main(void *arg) {
+  struct walk_thread *thread = arg;
+  struct walk_shared *shared = thread->shared;
+  struct walk_stack *own = shared->stacks + thread->index;
+
+  if (shared->walk->thread_start) {
+    shared->walk->thread_start(shared->walk->user);
+  }
+
+  while (!atomic_load_explicit(&shared->stop, memory_order_relaxed)) {
+    char *dir = walk_take(own, true);
+    for (int i = 1; !dir && i < shared->threads; ++i) {
+      dir = walk_take(shared->stacks + (thread->index + i) % shared->threads,
+                      false);
+    }
+
+    if (!dir) {
+      // a directory being read may still add more work
+      if (atomic_load_explicit(&shared->pending, memory_order_acquire) == 0) {
+        break;
+      }
+      struct timespec nap = {.tv_sec = 0, .tv_nsec = 50 * 1000};
+      nanosleep(&nap, NULL);
+      continue;
+    }
+
+    walk_read(shared, own, dir);
+    free(dir);
+    atomic_fetch_sub_explicit(&shared->pending, 1, memory_order_release);
+  }
+
+  return NULL;
+}
+
+bool rqshell_walk(char const *root, struct rqshell_walk const *walk) {
+  struct stat st;
+  if (stat(root, &st) != 0 || !S_ISDIR(st.st_mode)) {
+    return false;
+  }
+
+  long cores = sysconf(_SC_NPROCESSORS_ONLN);
+  struct walk_shared shared = {.walk = walk};
+  shared.threads = cores < 1 ? 1 : cores > WALK_THREADS ? WALK_THREADS : cores;
+  atomic_init(&shared.pending, 1);
+  atomic_init(&shared.stop, false);
+  for (int i = 0; i < shared.threads; ++i) {
+    pthread_mutex_init(&shared.stacks[i].lock, NULL);
+  }
+
+  char *first = strdup(root);
+  if (!first || !walk_push(shared.stacks, first)) {
+    free(first);
+    for (int i = 0; i < shared.threads; ++i) {
+      pthread_mutex_destroy(&shared.stacks[i].lock);
+    }
+    return false;
+  }
+
+  struct walk_thread threads[WALK_THREADS];
+  pthread_t ids[WALK_THREADS];
+  int started = 1;
+  for (int i = 0; i < shared.threads; ++i) {
+    threads[i] = (struct walk_thread){.shared = &shared, .index = i};
+  }
+  for (; started < shared.threads; ++started) {
+    if (pthread_create(ids + started, NULL, walk_main, threads + started) != 0) {
+      break;
+    }
+  }
+
+  walk_main(threads);
+  for (int i = 1; i < started; ++i) {
+    pthread_join(ids[i], NULL);
+  }
+
+  // a stopped walk leaves directories behind
+  for (int i = 0; i < shared.threads; ++i) {
+    struct walk_stack *stack = shared.stacks + i;
+    for (int j = stack->bottom; j < stack->top; ++j) {
+      free(stack->dirs[j]);
+    }
+    free(stack->dirs);
+    pthread_mutex_destroy(&stack->lock);
+  }
+
+  return true;
+}
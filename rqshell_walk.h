@@ -0,0 +1,41 @@
+#ifndef _HEADER_FILE_rqshell_walk_20261016194630_
+#define _HEADER_FILE_rqshell_walk_20261016194630_
+
+#include <stdbool.h>
+
+/*
+ * A file or directory found by rqshell_walk.
+ */
+struct rqshell_walk_entry {
+  char const *path; // the root joined with the path below it
+  char const *name; // last component of path
+  bool is_dir;
+  bool is_file; // a regular file, not a link, FIFO or device
+  unsigned long long size; // bytes, only filled in when stat is requested
+};
+
+/*
+ * What to do with a walk and how.
+ */
+struct rqshell_walk {
+  // called for every entry below the root, possibly from several threads at
+  // once, return false to stop the walk
+  bool (*visit)(struct rqshell_walk_entry const *entry, void *user);
+  // called on each walking thread before its first visit, may be null
+  void (*thread_start)(void *user);
+  void *user;
+  bool stat; // fill in the size of files
+};
+
+/*
+ * Walk the directory tree below root in parallel.
+ * Every thread keeps its own stack of directories still to read and steals
+ * from the others once its stack runs dry, so wide and deep trees both keep
+ * all threads busy. The calling thread takes part in the walk.
+ * Symbolic links are reported but not followed.
+ *
+ * Returns false if the root could not be read.
+ */
+bool rqshell_walk(char const *root, struct rqshell_walk const *walk);
+
+#endif
@@ -0,0 +1,190 @@
+#include "rqshell_workers.h"
+#include "rqshell_clock.h"
+#include <string.h>
+#include <time.h>
+
+// Oldest queued job, the caller holds the lock.
+static struct rqshell_job *workers_next_queued(struct rqshell_workers *pool) {
+  struct rqshell_job *next = NULL;
+  for (int i = 0; i < WORKER_JOBS; ++i) {
+    struct rqshell_job *job = pool->jobs + i;
+    if (job->state == RQSHELL_JOB_QUEUED &&
+        (!next || job->sequence < next->sequence)) {
+      next = job;
+    }
+  }
+  return next;
+}
+
+static void *workers_main(void *arg) {
+  struct rqshell_workers *pool = arg;
+
+  pthread_mutex_lock(&pool->lock);
+  while (!pool->stopping) {
+    struct rqshell_job *job = workers_next_queued(pool);
+    if (!job) {
+      pthread_cond_wait(&pool->wake, &pool->lock);
+      continue;
+    }
+
+    job->state = RQSHELL_JOB_RUNNING;
+    pthread_mutex_unlock(&pool->lock);
+
+    // a job cancelled while it was queued is not started at all
+    job->elapsed_ns = 0;
+    if (!atomic_load_explicit(&job->cancelled, memory_order_relaxed)) {
+      rqshell_workers_set_current(pool, job);
+      unsigned long long start = rqshell_now_ns();
+      job->handler(job, job->argc, job->argv);
+      job->elapsed_ns = rqshell_now_ns() - start;
+      rqshell_workers_set_current(pool, NULL);
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    job->state = RQSHELL_JOB_DONE;
+  }
+  pthread_mutex_unlock(&pool->lock);
+  return NULL;
+}
+
+void rqshell_workers_init(struct rqshell_workers *pool) {
+  memset(pool, 0, sizeof(*pool));
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->wake, NULL);
+  pthread_key_create(&pool->current, NULL);
+  for (int i = 0; i < WORKER_JOBS; ++i) {
+    atomic_init(&pool->jobs[i].cancelled, false);
+  }
+}
+
+void rqshell_workers_stop(struct rqshell_workers *pool) {
+  rqshell_workers_cancel_all(pool);
+
+  pthread_mutex_lock(&pool->lock);
+  pool->stopping = true;
+  pthread_cond_broadcast(&pool->wake);
+  pthread_mutex_unlock(&pool->lock);
+
+  for (int i = 0; i < pool->started; ++i) {
+    pthread_join(pool->threads[i], NULL);
+  }
+  pool->started = 0;
+  pool->stopping = false;
+
+  // nothing runs any more, so the lock is not needed
+  for (int i = 0; i < WORKER_JOBS; ++i) {
+    if (pool->jobs[i].state == RQSHELL_JOB_QUEUED) {
+      pool->jobs[i].state = RQSHELL_JOB_FREE;
+    }
+  }
+}
+
+struct rqshell_job *rqshell_workers_acquire(struct rqshell_workers *pool) {
+  struct rqshell_job *job = NULL;
+
+  pthread_mutex_lock(&pool->lock);
+  for (int i = 0; i < WORKER_JOBS && !job; ++i) {
+    if (pool->jobs[i].state == RQSHELL_JOB_FREE) {
+      job = pool->jobs + i;
+    }
+  }
+  pthread_mutex_unlock(&pool->lock);
+
+  if (job) {
+    atomic_store_explicit(&job->cancelled, false, memory_order_relaxed);
+  }
+  return job;
+}
+
+bool rqshell_workers_submit(struct rqshell_workers *pool,
+                            struct rqshell_job *job) {
+  pthread_mutex_lock(&pool->lock);
+
+  // start another thread while every started one may be busy
+  int busy = 0;
+  for (int i = 0; i < WORKER_JOBS; ++i) {
+    busy += pool->jobs[i].state == RQSHELL_JOB_QUEUED ||
+            pool->jobs[i].state == RQSHELL_JOB_RUNNING;
+  }
+  if (busy >= pool->started && pool->started < WORKER_THREADS &&
+      pthread_create(pool->threads + pool->started, NULL, workers_main, pool) ==
+          0) {
+    pool->started++;
+  }
+
+  bool queued = pool->started > 0;
+  if (queued) {
+    job->state = RQSHELL_JOB_QUEUED;
+    job->sequence = pool->submitted++;
+    pthread_cond_signal(&pool->wake);
+  }
+
+  pthread_mutex_unlock(&pool->lock);
+  return queued;
+}
+
+struct rqshell_job *rqshell_workers_next_done(struct rqshell_workers *pool) {
+  struct rqshell_job *done = NULL;
+
+  pthread_mutex_lock(&pool->lock);
+  for (int i = 0; i < WORKER_JOBS; ++i) {
+    struct rqshell_job *job = pool->jobs + i;
+    if (job->state == RQSHELL_JOB_DONE &&
+        (!done || job->sequence < done->sequence)) {
+      done = job;
+    }
+  }
+  pthread_mutex_unlock(&pool->lock);
+
+  return done;
+}
+
+void rqshell_workers_release(struct rqshell_workers *pool,
+                             struct rqshell_job *job) {
+  pthread_mutex_lock(&pool->lock);
+  job->state = RQSHELL_JOB_FREE;
+  pthread_mutex_unlock(&pool->lock);
+}
+
+int rqshell_workers_cancel_all(struct rqshell_workers *pool) {
+  int cancelled = 0;
+
+  pthread_mutex_lock(&pool->lock);
+  for (int i = 0; i < WORKER_JOBS; ++i) {
+    struct rqshell_job *job = pool->jobs + i;
+    if (job->state == RQSHELL_JOB_QUEUED || job->state == RQSHELL_JOB_RUNNING) {
+      atomic_store_explicit(&job->cancelled, true, memory_order_relaxed);
+      cancelled++;
+    }
+  }
+  pthread_mutex_unlock(&pool->lock);
+
+  return cancelled;
+}
+
+void rqshell_workers_foreach(struct rqshell_workers *pool,
+                             void (*f)(struct rqshell_job const *, void *),
+                             void *user) {
+  pthread_mutex_lock(&pool->lock);
+  for (int i = 0; i < WORKER_JOBS; ++i) {
+    struct rqshell_job const *job = pool->jobs + i;
+    if (job->state == RQSHELL_JOB_QUEUED || job->state == RQSHELL_JOB_RUNNING) {
+      f(job, user);
+    }
+  }
+  pthread_mutex_unlock(&pool->lock);
+}
+
+struct rqshell_job *rqshell_workers_current(struct rqshell_workers *pool) {
+  return pthread_getspecific(pool->current);
+}
+
+void rqshell_workers_set_current(struct rqshell_workers *pool,
+                                 struct rqshell_job *job) {
+  pthread_setspecific(pool->current, job);
+}
+
+void rqshell_workers_nap() {
+  struct timespec nap = {.tv_sec = 0, .tv_nsec = 1000 * 1000};
+  nanosleep(&nap, NULL);
+}
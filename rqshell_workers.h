@@ -0,0 +1,129 @@
+#ifndef _HEADER_FILE_rqshell_workers_20261016181204_
+#define _HEADER_FILE_rqshell_workers_20261016181204_
+
+#include "rqshell_config.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+
+enum rqshell_job_state {
+  RQSHELL_JOB_FREE, // the slot can be reused
+  RQSHELL_JOB_QUEUED,
+  RQSHELL_JOB_RUNNING,
+  RQSHELL_JOB_DONE, // finished, waiting to be released by the update thread
+};
+
+/*
+ * A command running on a worker thread, with its own copy of the arguments.
+ */
+struct rqshell_job {
+  enum rqshell_job_state state; // guarded by the pool lock
+  unsigned long long sequence; // submission order, oldest queued runs first
+  atomic_bool cancelled;
+
+  char const *name;
+  void (*handler)(struct rqshell_job *, int, char const **);
+  int argc;
+  char const *argv[N_ARGS + 1]; // points into line
+  char line[LINE_SIZE];
+
+  unsigned long long elapsed_ns; // time the handler ran, set by the worker
+
+  // output of a job run with the time keyword, counted by every thread
+  // printing for the job, see rqshell_job_attach
+  bool timed;
+  _Atomic unsigned printed_lines;
+  _Atomic unsigned long long printed_bytes;
+  _Atomic unsigned long long print_ns;
+};
+
+/*
+ * Worker thread pool.
+ * Jobs live in a fixed table of slots. The update thread fills a free slot
+ * and queues it, a worker runs it and marks it done, and the update thread
+ * then reports and releases it. The threads are only started once the first
+ * job is submitted.
+ */
+struct rqshell_workers {
+  pthread_mutex_t lock;
+  pthread_cond_t wake; // signalled when a job is queued or the pool stops
+  pthread_key_t current; // the job the calling worker thread is running
+
+  pthread_t threads[WORKER_THREADS];
+  int started; // number of threads running
+  bool stopping;
+
+  unsigned long long submitted;
+  struct rqshell_job jobs[WORKER_JOBS];
+};
+
+/*
+ * Set up an empty pool. No thread is started yet.
+ */
+void rqshell_workers_init(struct rqshell_workers *);
+
+/*
+ * Cancel all jobs, wait for the running ones to return and stop the threads.
+ * Jobs that have not started are discarded. Finished jobs stay done until
+ * they are taken with rqshell_workers_next_done.
+ */
+void rqshell_workers_stop(struct rqshell_workers *);
+
+/*
+ * Get a free job slot for the caller to fill in, or a null pointer if every
+ * slot is in use. Only the update thread may call this.
+ */
+struct rqshell_job *rqshell_workers_acquire(struct rqshell_workers *);
+
+/*
+ * Queue a job filled in after rqshell_workers_acquire.
+ *
+ * Returns false if no worker thread could be started, the job is then
+ * released again.
+ */
+bool rqshell_workers_submit(struct rqshell_workers *, struct rqshell_job *);
+
+/*
+ * Get a finished job, or a null pointer if none has finished.
+ * The job stays valid until it is given to rqshell_workers_release.
+ */
+struct rqshell_job *rqshell_workers_next_done(struct rqshell_workers *);
+
+/*
+ * Make the slot of a finished job free again.
+ */
+void rqshell_workers_release(struct rqshell_workers *, struct rqshell_job *);
+
+/*
+ * Request every queued and running job to stop.
+ *
+ * Returns the number of jobs asked to stop.
+ */
+int rqshell_workers_cancel_all(struct rqshell_workers *);
+
+/*
+ * Call f for every queued and running job.
+ * f must not submit or cancel jobs.
+ */
+void rqshell_workers_foreach(struct rqshell_workers *,
+                             void (*f)(struct rqshell_job const *, void *),
+                             void *user);
+
+/*
+ * The job run by the calling thread, or a null pointer when the calling
+ * thread is not a worker.
+ */
+struct rqshell_job *rqshell_workers_current(struct rqshell_workers *);
+
+/*
+ * Make job the one run by the calling thread, or none for a null pointer.
+ */
+void rqshell_workers_set_current(struct rqshell_workers *,
+                                 struct rqshell_job *job);
+
+/*
+ * Sleep the calling thread for about a millisecond.
+ */
+void rqshell_workers_nap();
+
+#endif